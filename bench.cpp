@@ -0,0 +1,229 @@
+/**
+ * The benchmark suite: btree against std::set and a sorted std::vector,
+ * on long keys and on the words in twl.txt, for each of
+ *
+ * insert_random  inserting the keys in random order
+ * insert_sorted  inserting them in ascending order
+ * insert_reverse inserting them in descending order
+ * find_hit       looking up every key
+ * find_miss      looking up as many keys that aren't there
+ * iterate        walking every key in order
+ * copy           copying the whole container
+ *
+ * with btree's maxNodeElems swept from 4 to 256. A sorted vector is built
+ * the way one would be: by appending everything and then sorting. Copying
+ * a btree only copies its root (see the copy constructor); assign_from is
+ * timed as copy_deep for a copy that shares nothing.
+ *
+ * Results go to stdout as CSV, one row per measurement:
+ *
+ *     container,keys,max_node_elems,op,ops,ns_per_op,cycles,instructions,
+ *     l1d_misses,llc_misses,branch_misses,dtlb_misses
+ *
+ * the hardware event counts being per op too, and left empty where they
+ * can't be counted (see perf_counters.h).
+ *
+ * Nodes never split, so sorted and reverse input build chains of nodes
+ * and take time quadratic in the number of keys; those runs use fewer.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "btree.h"
+#include "workload.h"
+
+namespace {
+
+const long kMinInteger = 1000000;
+const long kMaxInteger = 100000000;
+const std::size_t kNumKeys = 100000;
+const std::size_t kNumOrderedKeys = 10000;
+// copies are timed at least this many times, since some take next to no time
+const int kMinCopies = 10;
+
+workload::Xoshiro256 rng(6771);
+
+// what each container needs to do, so the runs below can treat them alike
+template <typename T>
+struct BtreeContainer {
+    explicit BtreeContainer(typename btree<T>::size_type maxNodeElems): tree(maxNodeElems) {}
+    void insert(const T& key) { tree.insert(key); }
+    void finish() {}
+    bool contains(const T& key) const { return tree.find(key) != tree.end(); }
+    const btree<T>& items() const { return tree; }
+    btree<T> tree;
+};
+
+template <typename T>
+struct SetContainer {
+    explicit SetContainer(std::size_t) {}
+    void insert(const T& key) { set.insert(key); }
+    void finish() {}
+    bool contains(const T& key) const { return set.find(key) != set.end(); }
+    const std::set<T>& items() const { return set; }
+    std::set<T> set;
+};
+
+template <typename T>
+struct SortedVectorContainer {
+    explicit SortedVectorContainer(std::size_t) {}
+    void insert(const T& key) { vector.push_back(key); }
+    void finish() {
+        std::sort(vector.begin(), vector.end());
+        vector.erase(std::unique(vector.begin(), vector.end()), vector.end());
+    }
+    bool contains(const T& key) const { return std::binary_search(vector.begin(), vector.end(), key); }
+    const std::vector<T>& items() const { return vector; }
+    std::vector<T> vector;
+};
+
+void row(const std::string& container, const std::string& keys, std::size_t maxNodeElems,
+         const std::string& op, std::size_t ops, const bench::Measurement& measured) {
+    std::cout << container << ',' << keys << ',';
+    if (maxNodeElems) {
+        std::cout << maxNodeElems;
+    }
+    std::cout << ',' << op << ',' << ops << ',' << measured.ns / ops;
+    for (const auto& count : measured.counts) {
+        std::cout << ',';
+        if (count.available) {
+            std::cout << count.count / ops;
+        }
+    }
+    std::cout << '\n';
+}
+
+template <typename Container, typename T>
+bench::Measurement timeInsert(std::size_t maxNodeElems, const std::vector<T>& keys, int rounds) {
+    return bench::measure([&] {
+        for (int round = 0; round < rounds; ++round) {
+            Container container(maxNodeElems);
+            for (const auto& key : keys) {
+                container.insert(key);
+            }
+            container.finish();
+            bench::doNotOptimise(container);
+        }
+    });
+}
+
+/**
+ * Runs every op on one kind of container. keys are in random order;
+ * misses aren't in keys; ordered are a few keys in ascending order.
+ * Everything is repeated rounds times, for keys too few to time once.
+ */
+template <typename Container, typename T>
+void run(const std::string& name, const std::string& keysName, std::size_t maxNodeElems,
+         const std::vector<T>& keys, const std::vector<T>& misses, const std::vector<T>& ordered, int rounds) {
+    std::size_t ops = keys.size() * rounds;
+    row(name, keysName, maxNodeElems, "insert_random", ops, timeInsert<Container>(maxNodeElems, keys, rounds));
+    row(name, keysName, maxNodeElems, "insert_sorted", ordered.size() * rounds,
+        timeInsert<Container>(maxNodeElems, ordered, rounds));
+    std::vector<T> reversed(ordered.rbegin(), ordered.rend());
+    row(name, keysName, maxNodeElems, "insert_reverse", reversed.size() * rounds,
+        timeInsert<Container>(maxNodeElems, reversed, rounds));
+
+    Container container(maxNodeElems);
+    for (const auto& key : keys) {
+        container.insert(key);
+    }
+    container.finish();
+
+    auto measured = bench::measure([&] {
+        for (int round = 0; round < rounds; ++round) {
+            for (const auto& key : keys) {
+                bench::doNotOptimise(container.contains(key));
+            }
+        }
+    });
+    row(name, keysName, maxNodeElems, "find_hit", ops, measured);
+
+    measured = bench::measure([&] {
+        for (int round = 0; round < rounds; ++round) {
+            for (const auto& key : misses) {
+                bench::doNotOptimise(container.contains(key));
+            }
+        }
+    });
+    row(name, keysName, maxNodeElems, "find_miss", misses.size() * rounds, measured);
+
+    std::size_t size = 0;
+    measured = bench::measure([&] {
+        for (int round = 0; round < rounds; ++round) {
+            for (const auto& key : container.items()) {
+                bench::doNotOptimise(key);
+                ++size;
+            }
+        }
+    });
+    row(name, keysName, maxNodeElems, "iterate", size, measured);
+
+    int copies = std::max(rounds, kMinCopies);
+    measured = bench::measure([&] {
+        for (int round = 0; round < copies; ++round) {
+            Container copy = container;
+            bench::doNotOptimise(copy);
+        }
+    });
+    row(name, keysName, maxNodeElems, "copy", copies, measured);
+}
+
+template <typename T>
+void runAll(const std::string& keysName, const std::vector<T>& keys, const std::vector<T>& misses,
+            const std::vector<T>& ordered, int rounds) {
+    for (std::size_t maxNodeElems = 4; maxNodeElems <= 256; maxNodeElems *= 2) {
+        run<BtreeContainer<T>>("btree", keysName, maxNodeElems, keys, misses, ordered, rounds);
+
+        BtreeContainer<T> container(maxNodeElems);
+        for (const auto& key : keys) {
+            container.insert(key);
+        }
+        btree<T> copy;
+        int copies = std::max(rounds, kMinCopies);
+        auto measured = bench::measure([&] {
+            for (int round = 0; round < copies; ++round) {
+                copy.assign_from(container.tree);
+                bench::doNotOptimise(copy);
+            }
+        });
+        row("btree", keysName, maxNodeElems, "copy_deep", copies, measured);
+    }
+    run<SetContainer<T>>("std::set", keysName, 0, keys, misses, ordered, rounds);
+    run<SortedVectorContainer<T>>("sorted_vector", keysName, 0, keys, misses, ordered, rounds);
+}
+
+}  // namespace
+
+int main(void) {
+    std::cout << "container,keys,max_node_elems,op,ops,ns_per_op,cycles,instructions,l1d_misses,llc_misses,"
+                 "branch_misses,dtlb_misses\n";
+
+    // odd keys to find, even ones to miss
+    std::vector<long> longs;
+    std::vector<long> longMisses;
+    for (std::size_t i = 0; i < kNumKeys; ++i) {
+        longs.push_back(rng.between(kMinInteger, kMaxInteger) | 1);
+        longMisses.push_back(rng.between(kMinInteger, kMaxInteger) & ~1L);
+    }
+    std::vector<long> orderedLongs(longs.begin(), longs.begin() + kNumOrderedKeys);
+    std::sort(orderedLongs.begin(), orderedLongs.end());
+    runAll("long", longs, longMisses, orderedLongs, 1);
+
+    // twl.txt is only so big, so go over it a few times
+    auto words = workload::loadWords("twl.txt");
+    std::vector<std::string> wordMisses;
+    for (const auto& word : words) {
+        // no word has a lowercase letter in it
+        wordMisses.push_back(word + "s");
+    }
+    std::vector<std::string> orderedWords = words;
+    std::sort(orderedWords.begin(), orderedWords.end());
+    workload::shuffle(rng, words);
+    runAll("twl", words, wordMisses, orderedWords, 100);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * Lookups in a big btree<long> whose nodes come from the global allocator,
+ * from cache-line aligned slabs, and from huge-page backed slabs (each node
+ * on cache lines of its own in the last two), with the data TLB misses
+ * (and other hardware events) each lookup costs where the kernel lets us
+ * count them.
+ *
+ *     g++ -std=c++17 -O2 -DNDEBUG bench_huge_pages.cpp -o bench_huge_pages
+ */
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "btree.h"
+#include "btree_huge_pages.h"
+#include "btree_pmr.h"
+#include "workload.h"
+
+namespace {
+
+const long kMinInteger = 1000000;
+const long kMaxInteger = 100000000;
+const std::size_t kNumKeys = 2000000;
+
+template <typename Tree>
+void build(Tree& tree, const std::vector<long>& keys) {
+    for (auto key : keys) {
+        tree.insert(key);
+    }
+}
+
+template <typename Tree>
+void run(const std::string& name, const Tree& tree, const std::vector<long>& keys) {
+    // look them up in a different order from the one they went in
+    std::vector<long> lookups(keys.rbegin(), keys.rend());
+    // dTLB misses are among the events counted, where they can be
+    auto measured = bench::measure([&] {
+        for (auto key : lookups) {
+            bench::doNotOptimise(tree.find(key));
+        }
+    });
+    bench::report(name + " find", lookups.size(), measured);
+}
+
+}  // namespace
+
+int main(void) {
+    workload::Xoshiro256 rng(6771);
+    auto keys = workload::uniform(rng, kNumKeys, kMinInteger, kMaxInteger);
+
+    for (btree<long>::size_type fanout : {8, 40}) {
+        std::string name = "fanout=" + std::to_string(fanout);
+        {
+            btree<long> tree(fanout, SearchPolicy::binary);
+            build(tree, keys);
+            run(name + " global allocator", tree, keys);
+        }
+        {
+            btree_huge_page_resource resource(false);
+            pmr::line_aligned_btree<long> tree(fanout, SearchPolicy::binary, &resource);
+            build(tree, keys);
+            run(name + " aligned slabs", tree, keys);
+        }
+        {
+            btree_huge_page_resource resource;
+            pmr::line_aligned_btree<long> tree(fanout, SearchPolicy::binary, &resource);
+            build(tree, keys);
+            std::string backing = resource.slab_count(btree_huge_page_resource::backing::huge_pages) ? "hugetlb" :
+                resource.slab_count(btree_huge_page_resource::backing::transparent) ? "thp" : "aligned";
+            run(name + " huge page slabs (" + backing + ")", tree, keys);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * Insert throughput for btree<long>: building a tree from random keys,
+ * which is mostly shifting elems along inside nodes, writing to fresh
+ * copies of a big tree, which is mostly copying the nodes on the way down,
+ * and erasing everything again, which shifts elems back.
+ *
+ * Elems are shifted with memmove; build it a second time with
+ * -DBTREE_ELEMENTWISE_SHIFT to compare with vector::insert and erase:
+ *
+ *     g++ -std=c++17 -O2 -DNDEBUG bench_insert.cpp -o bench_insert
+ *     g++ -std=c++17 -O2 -DNDEBUG -DBTREE_ELEMENTWISE_SHIFT bench_insert.cpp -o bench_insert_elementwise
+ */
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "btree.h"
+#include "workload.h"
+
+namespace {
+
+const long kMinInteger = 1000000;
+const long kMaxInteger = 100000000;
+const std::size_t kNumKeys = 1000000;
+const std::size_t kNumCopies = 100000;
+
+#ifdef BTREE_ELEMENTWISE_SHIFT
+const char* const kShift = "elementwise";
+#else
+const char* const kShift = "memmove";
+#endif
+
+void run(const std::vector<long>& keys, btree<long>::size_type fanout, SearchPolicy policy, const std::string& policyName) {
+    std::string name = std::string(kShift) + " fanout=" + std::to_string(fanout) + " " + policyName;
+
+    btree<long> tree(fanout, policy);
+    auto measured = bench::measure([&] {
+        for (auto key : keys) {
+            tree.insert(key);
+        }
+    });
+    bench::report(name + " insert", keys.size(), measured);
+
+    // each insert into a new copy copies every node on its way down
+    measured = bench::measure([&] {
+        for (std::size_t i = 0; i < kNumCopies; ++i) {
+            btree<long> copy = tree;
+            copy.insert(keys[i] + 1);
+            bench::doNotOptimise(copy);
+        }
+    });
+    bench::report(name + " copy + insert", kNumCopies, measured);
+
+    measured = bench::measure([&] {
+        for (auto key : keys) {
+            tree.erase(key);
+        }
+    });
+    bench::report(name + " erase", keys.size(), measured);
+}
+
+}  // namespace
+
+int main(void) {
+    workload::Xoshiro256 rng(6771);
+    auto keys = workload::uniform(rng, kNumKeys, kMinInteger, kMaxInteger);
+    for (btree<long>::size_type fanout : {40, 99, 256}) {
+        run(keys, fanout, SearchPolicy::linear, "linear");
+        run(keys, fanout, SearchPolicy::binary, "binary");
+    }
+    return 0;
+}
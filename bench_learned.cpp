@@ -0,0 +1,83 @@
+/**
+ * Compares lookups through a learned index against the tree's own descent,
+ * on uniformly random keys and on keys bunched into clusters of varying
+ * density, which is closer to what real ids look like.
+ */
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "btree.h"
+#include "btree_learned.h"
+#include "workload.h"
+
+namespace {
+
+const long kMinInteger = 1000000;
+const long kMaxInteger = 100000000;
+const std::size_t kNumKeys = 1000000;
+
+workload::Xoshiro256 rng(6771);
+
+// runs of consecutive-ish ids of random length and spacing, with gaps between runs
+std::vector<long> clusteredKeys() {
+    std::vector<long> keys;
+    long key = kMinInteger;
+    while (keys.size() < kNumKeys) {
+        long runLength = rng.between(1, 5000);
+        long spacing = rng.between(1, 20);
+        for (long i = 0; i < runLength && keys.size() < kNumKeys; ++i) {
+            key += rng.between(1, spacing);
+            keys.push_back(key);
+        }
+        key += rng.between(0, 1000000);
+    }
+    // look them up in random order
+    workload::shuffle(rng, keys);
+    return keys;
+}
+
+void run(const std::string& keysName, const std::vector<long>& keys, btree<long>::size_type fanout) {
+    btree<long> tree(fanout, SearchPolicy::binary);
+    for (auto key : keys) {
+        tree.insert(key);
+    }
+    std::string name = keysName + " fanout=" + std::to_string(fanout);
+
+    auto measured = bench::measure([&] {
+        for (auto key : keys) {
+            bench::doNotOptimise(tree.find(key));
+        }
+    });
+    bench::report(name + " btree find", keys.size(), measured);
+
+    for (std::size_t maxError : {8, 32, 128}) {
+        btree_learned_index<long>* index = nullptr;
+        measured = bench::measure([&] {
+            index = new btree_learned_index<long>(tree, maxError);
+        });
+        std::string indexName = name + " learned e=" + std::to_string(maxError);
+        bench::report(indexName + " build (" + std::to_string(index->segmentCount()) + " segs)", keys.size(), measured);
+
+        measured = bench::measure([&] {
+            for (auto key : keys) {
+                bench::doNotOptimise(index->find(key));
+            }
+        });
+        bench::report(indexName + " find", keys.size(), measured);
+        delete index;
+    }
+}
+
+}  // namespace
+
+int main(void) {
+    auto uniform = workload::uniform(rng, kNumKeys, kMinInteger, kMaxInteger);
+    auto clustered = clusteredKeys();
+    for (btree<long>::size_type fanout : {40, 99}) {
+        run("uniform", uniform, fanout);
+        run("clustered", clustered, fanout);
+    }
+    return 0;
+}
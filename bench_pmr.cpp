@@ -0,0 +1,69 @@
+/**
+ * Short-lived trees, as built (and thrown away) once per request: the
+ * global allocator against a std::pmr::monotonic_buffer_resource over a
+ * buffer that's reused from one request to the next.
+ *
+ *     g++ -std=c++17 -O2 -DNDEBUG bench_pmr.cpp -o bench_pmr
+ */
+
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "btree.h"
+#include "btree_pmr.h"
+#include "workload.h"
+
+namespace {
+
+// spread over however many requests it takes
+const std::size_t kTotalKeys = 1000000;
+
+workload::Xoshiro256 rng(6771);
+
+// builds a tree of keys, looks each one up, and lets the tree go
+template <typename Tree, typename... Args>
+void request(const std::vector<long>& keys, btree<long>::size_type fanout, Args&&... args) {
+    Tree tree(fanout, std::forward<Args>(args)...);
+    for (auto key : keys) {
+        tree.insert(key);
+    }
+    for (auto key : keys) {
+        bench::doNotOptimise(tree.find(key));
+    }
+}
+
+void run(std::size_t treeSize, btree<long>::size_type fanout) {
+    auto keys = workload::uniform(rng, treeSize, 0, 100000000);
+    std::size_t requests = kTotalKeys / treeSize;
+    std::string name = "size=" + std::to_string(treeSize) + " fanout=" + std::to_string(fanout);
+
+    auto measured = bench::measure([&] {
+        for (std::size_t i = 0; i < requests; ++i) {
+            request<btree<long>>(keys, fanout);
+        }
+    });
+    bench::report(name + " global allocator", requests, measured);
+
+    // big enough that a request never has to go back upstream
+    std::vector<char> buffer(treeSize * 256 + 4096);
+    measured = bench::measure([&] {
+        for (std::size_t i = 0; i < requests; ++i) {
+            std::pmr::monotonic_buffer_resource resource(buffer.data(), buffer.size());
+            request<pmr::btree<long>>(keys, fanout, &resource);
+        }
+    });
+    bench::report(name + " monotonic buffer", requests, measured);
+}
+
+}  // namespace
+
+int main(void) {
+    for (std::size_t treeSize : {100, 1000, 10000}) {
+        for (btree<long>::size_type fanout : {4, 40}) {
+            run(treeSize, fanout);
+        }
+    }
+    return 0;
+}
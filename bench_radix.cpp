@@ -0,0 +1,66 @@
+/**
+ * Compares lookups through the radix routing layer against the tree's own
+ * descent, on twl.txt and on URL-like keys that all share a long prefix.
+ */
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "btree.h"
+#include "btree_radix.h"
+#include "workload.h"
+
+namespace {
+
+void run(const std::string& keysName, const std::vector<std::string>& keys, btree<std::string>::size_type fanout) {
+    btree<std::string> tree(fanout, SearchPolicy::binary);
+    for (const auto& key : keys) {
+        tree.insert(key);
+    }
+    std::string name = keysName + " fanout=" + std::to_string(fanout);
+
+    const int rounds = 10;
+    auto measured = bench::measure([&] {
+        for (int round = 0; round < rounds; ++round) {
+            for (const auto& key : keys) {
+                bench::doNotOptimise(tree.find(key));
+            }
+        }
+    });
+    bench::report(name + " btree find", keys.size() * rounds, measured);
+
+    btree_radix_index* index = nullptr;
+    measured = bench::measure([&] {
+        index = new btree_radix_index(tree);
+    });
+    bench::report(name + " radix build (" + std::to_string(index->nodeCount()) + " nodes)", keys.size(), measured);
+
+    measured = bench::measure([&] {
+        for (int round = 0; round < rounds; ++round) {
+            for (const auto& key : keys) {
+                bench::doNotOptimise(index->find(key));
+            }
+        }
+    });
+    bench::report(name + " radix find", keys.size() * rounds, measured);
+    delete index;
+}
+
+}  // namespace
+
+int main(void) {
+    workload::Xoshiro256 rng(6771);
+    auto words = workload::loadWords("twl.txt");
+
+    std::vector<std::string> urls;
+    for (int i = 0; i < 200000; ++i) {
+        urls.push_back("https://example.com/users/" + std::to_string(rng.between(0, 2147483647)) + "/profile");
+    }
+
+    for (btree<std::string>::size_type fanout : {8, 40, 99}) {
+        run("twl", words, fanout);
+        run("urls", urls, fanout);
+    }
+    return 0;
+}
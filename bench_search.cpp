@@ -0,0 +1,89 @@
+/**
+ * Compares the node search policies on test01-style keys: uniformly random
+ * longs in [1e6, 1e8], which interpolation search should like, and the same
+ * number of keys bunched into a few tight clusters, which it shouldn't.
+ * Lookups through the hash index are timed too for comparison.
+ */
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "btree.h"
+#include "workload.h"
+
+namespace {
+
+const long kMinInteger = 1000000;
+const long kMaxInteger = 100000000;
+const std::size_t kNumKeys = 1000000;
+
+workload::Xoshiro256 rng(6771);
+
+const char* policyName(SearchPolicy policy) {
+    switch (policy) {
+        case SearchPolicy::binary: return "binary";
+        case SearchPolicy::interpolation: return "interpolation";
+        default: return "linear";
+    }
+}
+
+void run(const std::string& keysName, const std::vector<long>& keys, btree<long>::size_type fanout) {
+    btree<long> tree(fanout);
+    for (auto key : keys) {
+        tree.insert(key);
+    }
+
+    std::vector<long> misses;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        misses.push_back(rng.between(kMinInteger, kMaxInteger) | 1);
+    }
+
+    for (auto policy : {SearchPolicy::linear, SearchPolicy::binary, SearchPolicy::interpolation}) {
+        tree.search_policy(policy);
+        std::string name = keysName + " fanout=" + std::to_string(fanout) + " " + policyName(policy);
+
+        auto measured = bench::measure([&] {
+            for (auto key : keys) {
+                bench::doNotOptimise(tree.find(key));
+            }
+        });
+        bench::report(name + " find hit", keys.size(), measured);
+
+        measured = bench::measure([&] {
+            for (auto key : misses) {
+                bench::doNotOptimise(tree.find(key));
+            }
+        });
+        bench::report(name + " find any", misses.size(), measured);
+    }
+
+    tree.hash_index(true);
+    std::string name = keysName + " fanout=" + std::to_string(fanout) + " hash index";
+    auto measured = bench::measure([&] {
+        for (auto key : keys) {
+            bench::doNotOptimise(tree.find(key));
+        }
+    });
+    bench::report(name + " find hit", keys.size(), measured);
+
+    measured = bench::measure([&] {
+        for (auto key : misses) {
+            bench::doNotOptimise(tree.find(key));
+        }
+    });
+    bench::report(name + " find any", misses.size(), measured);
+}
+
+}  // namespace
+
+int main(void) {
+    auto uniform = workload::uniform(rng, kNumKeys, kMinInteger, kMaxInteger);
+    // 16 clusters a million wide spread over the same range
+    auto clustered = workload::clustered(rng, kNumKeys, kMinInteger, kMaxInteger, 16, 1000000);
+    for (btree<long>::size_type fanout : {40, 99, 256}) {
+        run("uniform", uniform, fanout);
+        run("clustered", clustered, fanout);
+    }
+    return 0;
+}
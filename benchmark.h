@@ -0,0 +1,118 @@
+/**
+ * Bits and pieces shared by the benchmark programs (bench_*.cpp).
+ * Like the btree itself everything here lives in the header, so each
+ * benchmark builds on its own from a single .cpp file, e.g.
+ *
+ *     g++ -std=c++17 -O2 -DNDEBUG bench_search.cpp -o bench_search
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "perf_counters.h"
+
+namespace bench {
+
+/**
+ * Stops the optimiser from throwing away a result we only computed to
+ * time it.
+ */
+template <typename T>
+inline void doNotOptimise(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * Runs f once and returns how long it took in nanoseconds.
+ */
+template <typename F>
+double timeNs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+// how long a region took, and the hardware events counted while it ran
+struct Measurement {
+    double ns;
+    std::vector<PerfCount> counts;
+};
+
+// this thread's counters, saying once on stderr if none of them can count
+inline PerfCounters& countersForMeasuring() {
+    auto& counters = PerfCounters::forThisThread();
+    static bool warned = false;
+    if (!warned && !counters.anyAvailable()) {
+        std::cerr << "hardware event counters aren't available; reporting times only\n";
+        warned = true;
+    }
+    return counters;
+}
+
+/**
+ * Runs f once like timeNs, counting hardware events (see perf_counters.h)
+ * for as long as it runs.
+ */
+template <typename F>
+Measurement measure(F&& f) {
+    auto& counters = countersForMeasuring();
+    counters.start();
+    double ns = timeNs(std::forward<F>(f));
+    return Measurement{ns, counters.stop()};
+}
+
+/**
+ * Prints one result line: what was measured, how many operations that
+ * was, and the average time each one took.
+ */
+inline void report(const std::string& name, std::size_t ops, double ns) {
+    // formatted on the side, so std::cout's flags are as the caller left them
+    std::ostringstream out;
+    out << std::left << std::setw(48) << name
+        << std::right << std::setw(12) << ops << " ops "
+        << std::fixed << std::setprecision(1) << std::setw(10) << ns / ops << " ns/op\n";
+    std::cout << out.str();
+}
+
+/**
+ * The same, followed by a line of whichever events were counted, each
+ * divided by ops, and instructions per cycle if both were counted.
+ */
+inline void report(const std::string& name, std::size_t ops, const Measurement& measurement) {
+    report(name, ops, measurement.ns);
+    double cycles = 0;
+    double instructions = 0;
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    for (const auto& count : measurement.counts) {
+        if (!count.available) {
+            continue;
+        }
+        out << " " << count.name << " " << count.count / ops;
+        if (std::string(count.name) == "cycles") {
+            cycles = count.count;
+        } else if (std::string(count.name) == "instructions") {
+            instructions = count.count;
+        }
+    }
+    if (cycles > 0 && instructions > 0) {
+        out << ", ipc " << instructions / cycles;
+    }
+    if (!out.str().empty()) {
+        std::cout << "    per op:" << out.str() << "\n";
+    }
+}
+
+}  // namespace bench
+
+#endif
@@ -10,34 +10,169 @@
 #ifndef BTREE_H
 #define BTREE_H
 
+#include <cassert>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <utility>
 #include <memory>
 #include <queue>
+#include <type_traits>
+#include <vector>
 
 // we better include the iterator
 #include "btree_iterator.h"
+#include "btree_hash_index.h"
+#include "btree_key_traits.h"
+#include "btree_latency.h"
+#include "btree_shape.h"
+#include "btree_small_vector.h"
+#include "btree_stats.h"
 
 // we do this to avoid compiler errors about non-template friends
 // what do we do, remember? :)
-template <typename T> class btree;
+template <typename T, typename Alloc = std::allocator<T>> class btree;
+template <typename T> class btree_learned_index;
+class btree_radix_index;
+template <typename T, typename Alloc> class btree_verifier;
+template <typename T, typename Alloc> class btree_trace_recorder;
 
-template<typename T>
-std::ostream& operator<<(std::ostream& os, const btree<T>& tree);
+template<typename T, typename Alloc>
+std::ostream& operator<<(std::ostream& os, const btree<T, Alloc>& tree);
 
-template <typename T>
+/**
+ * How a node is searched for the slot an element belongs in.
+ *
+ * linear        scans the node's elements from the left.
+ * binary        bisects the node's elements.
+ * interpolation guesses the slot from where the element falls between the
+ *               node's smallest and largest elements. Only arithmetic
+ *               elements (or normalized prefixes, see btree_key_traits.h)
+ *               can be interpolated; anything else, or a node whose
+ *               elements turn out to be skewed, is bisected instead.
+ */
+enum class SearchPolicy { linear, binary, interpolation };
+
+/**
+ * The alignment a btree allocating with Alloc gives its nodes, 0 meaning
+ * none beyond their own. allocate_shared puts a node just after its
+ * control block, so a cache-line aligned block doesn't make a cache-line
+ * aligned node; asking for 64 here pads nodes out to whole lines, which
+ * puts each one on a line of its own. The padding costs memory, so it's
+ * opt-in: specialize this for an allocator that can hand out blocks that
+ * aligned (btree_huge_pages.h does for btree_line_allocator).
+ */
+template <typename Alloc>
+struct btree_node_alignment : std::integral_constant<std::size_t, 0> {};
+
+/**
+ * Alloc supplies the storage for nodes and everything in them (see
+ * btree_pmr.h for trees allocating from a std::pmr::memory_resource).
+ *
+ * Like std::set's, both kinds of iterator only give const access to
+ * elements. Changing one in place could move it out of order, leave its
+ * normalized prefix and hash index entry stale, and change it in every
+ * copy sharing its node too. To change an element, extract it and insert
+ * it back.
+ */
+template <typename T, typename Alloc>
 class btree {
     public:
         /** Hmm, need some iterator typedefs here... friends? **/
-        using iterator = BTreeIterator<T>;
-        using const_iterator = BTreeIterator<const T>; // does this actually work?
+        using iterator = BTreeIterator<T, Alloc>;
+        using const_iterator = BTreeIterator<const T, Alloc>; // does this actually work?
         using reverse_iterator = std::reverse_iterator<iterator>;
         using const_reverse_iterator = std::reverse_iterator<const_iterator>;
         friend iterator;
         friend const_iterator;
+        friend class btree_learned_index<T>;
+        friend class btree_radix_index;
+        friend class btree_verifier<T, Alloc>;
+        friend class btree_trace_recorder<T, Alloc>;
 
         using size_type = unsigned int;
+        using allocator_type = Alloc;
+
+        /**
+         * Owns one element taken out of a tree by extract, until it's put
+         * into another by insert, like std::set's node handles. Elements
+         * don't have nodes of their own here, so the handle holds the
+         * element itself; it's moved in and out, never copied.
+         */
+        class node_type {
+            public:
+                using value_type = T;
+
+                node_type() = default;
+
+                node_type(node_type&& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+                    if (!other.empty()) {
+                        emplace_(std::move(other.value()));
+                        other.reset_();
+                    }
+                }
+
+                node_type& operator=(node_type&& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+                    if (this != &other) {
+                        reset_();
+                        if (!other.empty()) {
+                            emplace_(std::move(other.value()));
+                            other.reset_();
+                        }
+                    }
+                    return *this;
+                }
+
+                ~node_type() {
+                    reset_();
+                }
+
+                bool empty() const {
+                    return !engaged;
+                }
+
+                explicit operator bool() const {
+                    return engaged;
+                }
+
+                // the element; only there if the handle isn't empty
+                T& value() {
+                    return *reinterpret_cast<T*>(&storage);
+                }
+
+                const T& value() const {
+                    return *reinterpret_cast<const T*>(&storage);
+                }
+
+            private:
+                friend class btree;
+
+                void emplace_(T&& elem) {
+                    new (&storage) T(std::move(elem));
+                    engaged = true;
+                }
+
+                void reset_() {
+                    if (engaged) {
+                        value().~T();
+                        engaged = false;
+                    }
+                }
+
+                typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+                bool engaged = false;
+        };
+
+        // what insert(node_type&&) returns: where the element is, and the handle back if it wasn't inserted
+        struct insert_return_type {
+            iterator position;
+            bool inserted;
+            node_type node;
+        };
 
         /**
          * Constructs an empty btree.  Note that
@@ -51,8 +186,13 @@ class btree {
          *
          * @param maxNodeElems the maximum number of elements
          *        that can be stored in each B-Tree node
+         * @param searchPolicy how each node is searched on the way down
+         * @param alloc where nodes get their storage from
          */
-        btree(size_type maxNodeElems_ = 40) : maxNodeElems{maxNodeElems_} {}
+        btree(size_type maxNodeElems_ = 40, SearchPolicy searchPolicy_ = SearchPolicy::linear, const Alloc& alloc_ = Alloc())
+            : maxNodeElems{maxNodeElems_}, searchPolicy{searchPolicy_}, alloc{alloc_} {}
+
+        btree(size_type maxNodeElems_, const Alloc& alloc_): btree(maxNodeElems_, SearchPolicy::linear, alloc_) {}
 
         /**
          * The copy constructor and  assignment operator.
@@ -61,6 +201,18 @@ class btree {
          * they make for an interesting programming exercise.
          * Implement these operations using value semantics and
          * make sure they do not leak memory.
+         *
+         * Copies are cheap: only the root node is copied, and every node
+         * under it is shared (copy-on-write) between the copies. The first
+         * write to a shared node copies it, along with the path of nodes
+         * above it, so copies only cost memory once they start to differ.
+         * With the hash index on, its table is copied too.
+         *
+         * Only trees whose allocators compare equal share nodes. A copy
+         * with an allocator of its own (a pmr::btree on another resource,
+         * say) copies every node into its own storage straight away, as
+         * assign_from does, so it never points into storage that may go
+         * before it does.
          */
 
         /**
@@ -69,9 +221,26 @@ class btree {
          *
          * @param original a const lvalue reference to a B-Tree object
          */
-        btree(const btree<T>& original): maxNodeElems{original.maxNodeElems} {
-            // make a unique copy of what original.head points to
-            head = std::make_unique<Node>(*original.head, nullptr);
+        btree(const btree& original)
+            : btree(original, std::allocator_traits<Alloc>::select_on_container_copy_construction(original.alloc)) {}
+
+        // the same, with alloc for our own nodes
+        btree(const btree& original, const Alloc& alloc_)
+            : maxNodeElems{original.maxNodeElems}, searchPolicy{original.searchPolicy}, alloc{alloc_} {
+            if (!(alloc == original.alloc)) {
+                assign_from(original);
+                return;
+            }
+            if (original.head) {
+                // everything below the root is shared until one of us writes to it
+                head = std::allocate_shared<StoredNode>(alloc, *original.head, alloc);
+                BTREE_COUNT(allocations, 1);
+            }
+            if (original.hashIndex) {
+                // the index is ours alone, and our root's elems now live in our root
+                hashIndex = std::make_unique<HashIndex>(*original.hashIndex);
+                rehome_(original.head.get(), head.get());
+            }
         }
 
         /**
@@ -80,7 +249,7 @@ class btree {
          *
          * @param original an rvalue reference to a B-Tree object
          */
-        btree(btree<T>&& original): maxNodeElems{original.maxNodeElems} {
+        btree(btree&& original): maxNodeElems{original.maxNodeElems}, searchPolicy{original.searchPolicy}, alloc{original.alloc} {
             swap(original, *this);
         }
 
@@ -90,10 +259,112 @@ class btree {
          *
          * @param rhs a const lvalue reference to a B-Tree object
          */
-        btree<T>& operator=(const btree<T>& rhs) {
-            // copy and swap
-            btree tmp = rhs;
-            swap(tmp, *this);
+        btree& operator=(const btree& rhs) {
+            if (this == &rhs) {
+                return *this;
+            }
+            if (!(alloc == rhs.alloc)) {
+                // rhs's nodes may not last as long as we do
+                return assign_from(rhs);
+            }
+            // what we had goes on the free list, so the new root (and our
+            // first writes to shared nodes) can reuse it rather than allocate
+            clear();
+            maxNodeElems = rhs.maxNodeElems;
+            searchPolicy = rhs.searchPolicy;
+            if (rhs.head) {
+                auto root = newNode_();
+                *root = *rhs.head;
+                head = std::move(root);
+            }
+            if (rhs.hashIndex) {
+                if (hashIndex) {
+                    *hashIndex = *rhs.hashIndex;
+                } else {
+                    hashIndex = std::make_unique<HashIndex>(*rhs.hashIndex);
+                }
+                rehome_(rhs.head.get(), head.get());
+            } else {
+                hashIndex.reset();
+            }
+            return *this;
+        }
+
+        /**
+         * Makes this a copy of other which shares nothing with it, reusing
+         * our own nodes (and the storage in them) wherever ours has a node
+         * in the same place as other's. Nodes left over go on the free list.
+         *
+         * Unlike copy assignment, nothing needs copying later when either
+         * tree is written to, and all of our nodes come from our allocator.
+         * The hash index is on afterwards if it's on in other. If copying an
+         * element throws, this tree is left empty.
+         *
+         * @param other the tree to copy
+         * @return this tree
+         */
+        btree& assign_from(const btree& other) {
+            if (this == &other) {
+                return *this;
+            }
+            maxNodeElems = other.maxNodeElems;
+            searchPolicy = other.searchPolicy;
+            if (!other.hashIndex) {
+                hashIndex.reset();
+            } else if (hashIndex) {
+                hashIndex->clear();
+            } else {
+                hashIndex = std::make_unique<HashIndex>();
+            }
+
+            // each of our node slots paired with the node of other's that goes there
+            std::vector<std::pair<std::shared_ptr<Node>*, const Node*>> pending;
+            if (other.head) {
+                pending.emplace_back(&head, other.head.get());
+            } else {
+                release_(std::move(head), true);
+            }
+            while (!pending.empty()) {
+                std::shared_ptr<Node>& ours = *pending.back().first;
+                const Node* theirs = pending.back().second;
+                pending.pop_back();
+
+                if (ours && ours.use_count() > 1) {
+                    // shared with another copy, so not ours to overwrite
+                    ours.reset();
+                }
+                if (!ours) {
+                    ours = newNode_();
+                }
+                Node* node = ours.get();
+                try {
+                    node->elems = theirs->elems;
+                    node->prefixes = theirs->prefixes;
+                } catch (...) {
+                    // the elems we got this far don't make a tree
+                    release_(std::move(head), true);
+                    throw;
+                }
+
+                // what we have beyond their children, or where they have none, is spare
+                for (size_type i = theirs->children.size(); i < node->children.size(); ++i) {
+                    release_(std::move(node->children[i]), true);
+                }
+                node->children.resize(theirs->children.size());
+                for (size_type i = 0; i < theirs->children.size(); ++i) {
+                    if (theirs->children[i]) {
+                        pending.emplace_back(&node->children[i], theirs->children[i].get());
+                    } else {
+                        release_(std::move(node->children[i]), true);
+                    }
+                }
+            }
+
+            if (hashIndex) {
+                forEachInOrder_([this](Node* node, size_type i) {
+                    hashIndex->insert(hashOf_(node->elems[i]), node);
+                });
+            }
             return *this;
         }
 
@@ -102,10 +373,34 @@ class btree {
          * Replaces the contents of this object with the "stolen"
          * contents of original.
          *
-         * @param rhs a const reference to a B-Tree object
+         * Nodes are only stolen if we'll free them the way rhs would: if
+         * our allocators compare equal, or rhs's comes with its nodes.
+         * Otherwise (e.g. pmr::btrees on different resources) rhs's nodes
+         * could outlive the resource they came from, so we copy its elems
+         * into nodes of our own instead, as assign_from does, and leave
+         * rhs as it was.
+         *
+         * @param rhs an rvalue reference to a B-Tree object
          */
-        btree<T>& operator=(btree<T>&& rhs) {
+        btree& operator=(btree&& rhs) {
+            if (this == &rhs) {
+                return *this;
+            }
+            using Propagate = typename std::allocator_traits<Alloc>::propagate_on_container_move_assignment;
+            if (!(alloc == rhs.alloc)) {
+                if (!Propagate::value) {
+                    return assign_from(rhs);
+                }
+                // what we have goes back to our allocator before we take rhs's
+                release_(std::move(head), false);
+                freeNodes.clear();
+                if (hashIndex) {
+                    hashIndex->clear();
+                }
+                adoptAlloc_(alloc, rhs.alloc, Propagate());
+            }
             maxNodeElems = rhs.maxNodeElems;
+            searchPolicy = rhs.searchPolicy;
             swap(rhs, *this);
             return *this;
         }
@@ -119,31 +414,16 @@ class btree {
          * @param tree a const reference to a B-Tree object
          * @return a reference to os
          */
-        friend std::ostream& operator<<(std::ostream& os, const btree<T>& tree) {
-            std::queue<Node*> queue;
-            if (tree.head) {
-                queue.push(tree.head.get());
-            }
-            while (!queue.empty()) {
-                // add nodes' children to queue
-                for (auto& child : queue.front()->children) {
-                    if (child) { // child.get != nullptr
-                        queue.push(child.get());
-                    }
+        friend std::ostream& operator<<(std::ostream& os, const btree& tree) {
+            bool first = true;
+            tree.forEachBreadthFirst_([&os, &first](Node* node, size_type i) {
+                // only print space if something came before
+                if (!first) {
+                    os << ' ';
                 }
-
-                // print the nodes' contents
-                const std::vector<T> elems = queue.front()->elems;
-                for (size_type i = 0; i < elems.size(); ++i) {
-                    os << elems.at(i); // print elem
-                    if (i < elems.size() - 1 || queue.size() > 1) {
-                        // only print space if something else afterward
-                        // i.e. if i is not the last elem or there are more things on the queue
-                        os << ' ';
-                    }
-                }
-                queue.pop();
-            }
+                os << node->elems[i];
+                first = false;
+            });
             return os;
         }
 
@@ -187,6 +467,42 @@ class btree {
             return std::reverse_iterator<const_iterator>(cbegin());
         }
 
+        allocator_type get_allocator() const {
+            return alloc;
+        }
+
+        SearchPolicy search_policy() const {
+            return searchPolicy;
+        }
+
+        /**
+         * Changes how nodes are searched. This only affects how fast
+         * lookups are, never what they find.
+         */
+        void search_policy(SearchPolicy searchPolicy_) {
+            searchPolicy = searchPolicy_;
+        }
+
+        bool hash_index() const {
+            return hashIndex != nullptr;
+        }
+
+        /**
+         * Turns the hash index on or off. While it's on, the tree also keeps
+         * a hash table from each element to the node holding it, and find
+         * looks elements up there instead of searching down the tree.
+         * Iteration isn't affected. Turning it on needs std::hash<T>;
+         * turning it off doesn't, so trees of unhashable things can still
+         * call this with false (asking for true on them is an error).
+         */
+        void hash_index(bool enabled) {
+            if (enabled) {
+                enableHashIndex_(Hashable<T>());
+            } else {
+                hashIndex.reset();
+            }
+        }
+
         /**
          * Returns an iterator to the matching element, or whatever
          * the non-const end() returns if the element could
@@ -218,6 +534,18 @@ class btree {
             return static_cast<const_iterator>(find_(elem));
         }
 
+        /**
+         * The first element not less than elem, or end() if there's none;
+         * where a scan of everything from elem onwards starts.
+         */
+        iterator lower_bound(const T& elem) {
+            return lowerBound_(elem);
+        }
+
+        const_iterator lower_bound(const T& elem) const {
+            return static_cast<const_iterator>(lowerBound_(elem));
+        }
+
         /**
          * Operation which inserts the specified element
          * into the btree if a matching element isn't already
@@ -246,55 +574,293 @@ class btree {
          *         because no matching element was there prior to the insert call.
          */
         std::pair<iterator, bool> insert(const T& elem) {
-            iterator it = find(elem);
-            if (it != end()) {
-                // already in btree so do nothing
-                return std::make_pair(it, false);
+            const Probe probe = makeProbe_(elem);
+            return insert_([&](const Node* node) { return search_(node, probe); },
+                    [&](const T& other) { return other == elem; },
+                    [&]() -> const T& { return elem; });
+        }
+
+        /**
+         * Same as insert(const T&), but moves elem into the tree instead
+         * of copying it. elem is left alone if it's already there.
+         */
+        std::pair<iterator, bool> insert(T&& elem) {
+            const Probe probe = makeProbe_(elem);
+            return insert_([&](const Node* node) { return search_(node, probe); },
+                    [&](const T& other) { return other == elem; },
+                    [&]() -> T&& { return std::move(elem); });
+        }
+
+        /**
+         * Moves the element nh holds into the tree, as insert(T&&) does,
+         * emptying nh. If a matching element is already there, the
+         * element stays in the handle returned with position pointing at
+         * the one that's there.
+         *
+         * @return where the element is, whether it went in, and the handle
+         *         if it didn't; position is end() if nh was empty
+         */
+        insert_return_type insert(node_type&& nh) {
+            if (nh.empty()) {
+                return insert_return_type{end(), false, node_type()};
+            }
+            auto result = insert(std::move(nh.value()));
+            if (result.second) {
+                nh.reset_();
+                return insert_return_type{result.first, true, node_type()};
+            }
+            return insert_return_type{result.first, false, std::move(nh)};
+        }
+
+        /**
+         * Constructs an element from args and moves it in as insert does.
+         * Like std::set::emplace, the element is constructed even if it
+         * turns out to be there already; try_emplace avoids that.
+         */
+        template <typename... Args>
+        std::pair<iterator, bool> emplace(Args&&... args) {
+            return insert(T(std::forward<Args>(args)...));
+        }
+
+        /**
+         * Inserts T(key, args...) unless an element matching key is already
+         * there, in which case nothing is constructed at all. key is looked
+         * up as is, so it needs operator< and operator== with T, e.g. a
+         * const char* for a btree<std::string>.
+         */
+        template <typename K, typename... Args>
+        std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+            return insert_([&](const Node* node) { return searchKey_(node, key); },
+                    [&](const T& other) { return other == key; },
+                    [&]() { return T(std::forward<K>(key), std::forward<Args>(args)...); });
+        }
+
+        /**
+         * Removes the element matching elem, if there is one. The size of
+         * the btree shrinks by one if so and stays the same otherwise.
+         * Iterators into the btree are no longer valid afterwards.
+         *
+         * Nodes left empty are kept (up to free_nodes() of them) and reused
+         * when the tree next needs a node, along with their storage.
+         *
+         * @param elem the element to be removed.
+         * @return how many elements were removed, i.e. 1 or 0.
+         */
+        size_type erase(const T& elem) {
+            return erase_(elem, [](T&&) {});
+        }
+
+        /**
+         * Takes the element matching elem out of the tree, as erase does,
+         * and hands it back in a node handle, moved rather than copied.
+         *
+         * @return a handle holding the element, or an empty one if there
+         *         was no matching element
+         */
+        node_type extract(const T& elem) {
+            node_type nh;
+            erase_(elem, [&nh](T&& taken) { nh.emplace_(std::move(taken)); });
+            return nh;
+        }
+
+        /**
+         * Moves every element of source that isn't in this tree yet into
+         * it, without copying any. Elements already here stay in source.
+         */
+        void merge(btree& source) {
+            if (&source == this) {
+                return;
             }
+            auto it = source.cbegin();
+            while (it != source.cend()) {
+                if (find(*it) != end()) {
+                    ++it;
+                    continue;
+                }
+                auto result = insert(source.extract(*it));
+                // extracting moved things about in source, so find our place again
+                it = source.lowerBound_(*result.position);
+            }
+        }
 
+        /**
+         * Measures the shape of the tree: how tall it is, how full each
+         * level's nodes are, and where it has grown long chains. See
+         * btree_shape.h. Takes one walk over the nodes.
+         */
+        btree_shape shape_report() const {
+            btree_shape shape;
+            shape.max_node_elems = maxNodeElems;
             if (!head) {
-                head = std::make_unique<Node>(nullptr);
+                return shape;
             }
 
-            Node* node = head.get();
-            std::stack<size_type> indices;
+            // a node on the way down, the next child of it to look at, and
+            // how many nodes in a row down to it have had just one child
+            struct Frame {
+                const Node* node;
+                size_type next;
+                std::size_t chain;
+            };
+            std::vector<Frame> stack;
+            shape.min_leaf_depth = static_cast<std::size_t>(-1);
 
-            while (true) {
-                // find index
-                size_type i = 0;
-                auto elemIt = node->elems.begin();
-                auto childrenIt = node->children.begin();
-                while (elemIt != node->elems.end()) {
-                    if (elem < *elemIt) {
-                        break;
-                    }
-                    ++elemIt;
-                    ++i;
-                    if (childrenIt != node->children.end()) {
-                        ++childrenIt;
-                    }
+            auto visit = [&](const Node* node, std::size_t parentChain) {
+                std::size_t depth = stack.size();
+                if (shape.levels.size() <= depth) {
+                    shape.levels.resize(depth + 1);
                 }
-                indices.push(i);
+                auto& level = shape.levels[depth];
+                ++level.nodes;
+                level.elems += node->elems.size();
+                std::size_t tenths = maxNodeElems ? node->elems.size() * 10 / maxNodeElems : 9;
+                ++level.fill[tenths < 9 ? tenths : 9];
+                ++shape.node_count;
+                shape.elem_count += node->elems.size();
 
-                // if node not saturated add to it and return iterator
-                if (node->elems.size() < maxNodeElems) {
-                    node->elems.insert(elemIt, elem);
-                    if (childrenIt != node->children.end()) {
-                        node->children.insert(childrenIt, nullptr);
+                std::size_t children = 0;
+                for (const auto& child : node->children) {
+                    children += child != nullptr;
+                }
+                std::size_t chain = children == 1 ? parentChain + 1 : 0;
+                if (chain > shape.longest_chain) {
+                    shape.longest_chain = chain;
+                }
+                if (children == 0) {
+                    if (depth < shape.min_leaf_depth) {
+                        shape.min_leaf_depth = depth;
+                    }
+                    if (depth > shape.max_leaf_depth) {
+                        shape.max_leaf_depth = depth;
+                        shape.longest_path.clear();
+                        for (const auto& frame : stack) {
+                            shape.longest_path.push_back(frame.next - 1);
+                        }
                     }
-                    return std::make_pair(iterator(node, indices), true);
                 }
+                stack.push_back(Frame{node, 0, chain});
+            };
 
-                // otherwise add to child
-                if (i >= node->children.size()) {
-                    // extend to fit
-                    node->children.resize(i + 1);
+            visit(head.get(), 0);
+            while (!stack.empty()) {
+                Frame& frame = stack.back();
+                while (frame.next < frame.node->children.size() && !frame.node->children[frame.next]) {
+                    ++frame.next;
                 }
-                if (node->children[i] == nullptr) {
-                    // create actual child if doesnt exist yet
-                    node->children[i] = std::make_unique<Node>(node);
+                if (frame.next == frame.node->children.size()) {
+                    stack.pop_back();
+                    continue;
                 }
-                node = node->children[i].get();
+                const Node* child = frame.node->children[frame.next++].get();
+                visit(child, frame.chain);
+            }
+            shape.height = shape.levels.size();
+            return shape;
+        }
+
+        /**
+         * A snapshot of the calling thread's operation counts, across every
+         * btree, since it started or last called reset_stats(). They're only
+         * counted when the whole program is built with BTREE_STATS defined;
+         * see btree_stats.h.
+         */
+        static btree_stats stats() {
+            return btree_stats::local();
+        }
+
+        static void reset_stats() {
+            btree_stats::local() = btree_stats();
+        }
+
+        /**
+         * Times one in every `every` finds, inserts and erases each thread
+         * does on this tree, 0 being none; see btree_latency.h. Changing it
+         * starts the histograms afresh. Copies start with sampling off.
+         */
+        void latency_sampling(unsigned every) {
+            if (every == 0) {
+                latencyRecorder.reset();
+            } else if (!latencyRecorder || latencyRecorder->sampling() != every) {
+                latencyRecorder = std::make_unique<btree_latency_recorder>(every);
+            }
+        }
+
+        unsigned latency_sampling() const {
+            return latencyRecorder ? latencyRecorder->sampling() : 0;
+        }
+
+        // percentiles of the op latencies sampled so far, merged across threads
+        btree_latency_summary latency(TimedOp op) const {
+            return latencyRecorder ? latencyRecorder->summary(op) : btree_latency_summary();
+        }
+
+        void reset_latency() {
+            if (latencyRecorder) {
+                latencyRecorder->reset();
+            }
+        }
+
+        // how many emptied nodes the tree holds on to for reuse
+        size_type free_nodes() const {
+            return maxFreeNodes;
+        }
+
+        /**
+         * Changes how many emptied nodes the tree holds on to for reuse,
+         * letting go of any beyond that straight away.
+         */
+        void free_nodes(size_type maxFreeNodes_) {
+            maxFreeNodes = maxFreeNodes_;
+            if (freeNodes.size() > maxFreeNodes) {
+                freeNodes.resize(maxFreeNodes);
+            }
+        }
+
+        /**
+         * Removes every element. The nodes that held them go on the free
+         * list (as many as it has room for) to be reused by later inserts.
+         * The hash index, if on, stays on.
+         */
+        void clear() {
+            release_(std::move(head), true);
+            if (hashIndex) {
+                hashIndex->clear();
+            }
+        }
+
+        /**
+         * Gets enough nodes ready on the free list, storage and all, for
+         * n elements to be inserted into an empty tree in any order without
+         * allocating any nodes, raising free_nodes() to match if need be.
+         * Nodes here don't split, so partly full ones stay that way: at
+         * worst (n - 1)(m + 1) / 2m + 1 of them for nodes of m elements,
+         * close to twice what n elements packed full would take. A tree
+         * that already has elements may need a node for each new one at
+         * worst, so it may still allocate some.
+         *
+         * @param n how many elements to make room for
+         */
+        void reserve(size_type n) {
+            // in 64 bits, so neither the product nor the rounding up overflows
+            std::uint64_t m = maxNodeElems;
+            std::uint64_t needed = 0;
+            if (n > 0) {
+                // with m of 0 the root stays empty and every elem spills into a node of its own
+                needed = m == 0 ? n + 1 : ((n - 1) * (m + 1) + 2 * m - 1) / (2 * m) + 1;
+            }
+            size_type nodes = needed < std::numeric_limits<size_type>::max()
+                ? static_cast<size_type>(needed) : std::numeric_limits<size_type>::max();
+            if (maxFreeNodes < nodes) {
+                maxFreeNodes = nodes;
+            }
+            size_type perNode = n < maxNodeElems ? n : maxNodeElems;
+            for (auto& node : freeNodes) {
+                node->reserve(perNode);
+            }
+            while (freeNodes.size() < nodes) {
+                freeNodes.push_back(std::allocate_shared<StoredNode>(alloc, alloc));
+                BTREE_COUNT(allocations, 1);
+                freeNodes.back()->reserve(perNode);
             }
         }
 
@@ -304,93 +870,856 @@ class btree {
          * inserted using the insert operation.
          * Check that your implementation does not leak memory!
          */
-        ~btree() = default;
+        ~btree() {
+            release_(std::move(head), false);
+        }
 
     private:
+        using keyTraits = btree_key_traits<T>;
+        using Normalized = std::integral_constant<bool, keyTraits::normalized>;
+
+        // a vector whose storage comes from Alloc
+        template <typename U>
+        using Vector = std::vector<U, typename std::allocator_traits<Alloc>::template rebind_alloc<U>>;
+
+        // stands in for the prefix of elements that aren't normalized
+        struct NoPrefix {
+            NoPrefix() = default;
+            // so Node can build it like the vector it stands in for
+            explicit NoPrefix(const Alloc&) {}
+            NoPrefix(const NoPrefix&, const Alloc&) {}
+        };
+        template <typename Traits, bool = Traits::normalized>
+        struct PrefixOf {
+            using type = NoPrefix;
+            using vector = NoPrefix;
+        };
+        template <typename Traits>
+        struct PrefixOf<Traits, true> {
+            using type = typename Traits::prefix_type;
+            using vector = Vector<type>;
+        };
+        using Prefix = typename PrefixOf<keyTraits>::type;
+        using Prefixes = typename PrefixOf<keyTraits>::vector;
+
+        // what a search looks for: the elem and, if T has one, its prefix
+        struct Probe {
+            const T& elem;
+            Prefix prefix;
+        };
+
         struct Node {
-            Node(Node* parent_): parent{parent_} {};
+            explicit Node(const Alloc& alloc): elems(alloc), prefixes(alloc), children(alloc) {}
 
-            Node(const Node& original, Node* parent_): elems(original.elems), parent{parent_} {
-                for (const auto& child : original.children) {
-                    if (child != nullptr) {
-                        // make a unique copy of each child
-                        children.push_back(std::make_unique<Node>(*child, this));
-                    } else {
-                        children.push_back(nullptr);
-                    }
-                }
+            // copies original's elems but shares its children
+            Node(const Node& original, const Alloc& alloc)
+                : elems(original.elems, alloc), prefixes(original.prefixes, alloc), children(original.children, alloc) {}
+
+            // puts elem at index i, keeping prefixes in step
+            template <typename U>
+            void insertElem(size_type i, U&& elem) {
+                // the prefix has to come first in case elem gets moved from
+                insertPrefix_(i, elem, Normalized());
+                shiftIn_(elems, i, std::forward<U>(elem));
+            }
+
+            // replaces the elem at index i
+            void setElem(size_type i, T&& elem) {
+                setPrefix_(i, elem, Normalized());
+                elems[i] = std::move(elem);
+            }
+
+            void eraseElem(size_type i) {
+                shiftOut_(elems, i);
+                erasePrefix_(i, Normalized());
+            }
+
+            // makes room for n elems without reallocating
+            void reserve(size_type n) {
+                elems.reserve(n);
+                reservePrefixes_(n, Normalized());
+            }
+
+            // empties the node but keeps its storage
+            void clear() {
+                elems.clear();
+                clearPrefixes_(Normalized());
+                children.clear();
             }
 
-            std::vector<T> elems;
-            std::vector<std::unique_ptr<Node>> children;
-            Node* parent;
+            Vector<T> elems;
+            // prefixes[i] is the normalized prefix of elems[i], if T has them
+            Prefixes prefixes;
+            // children may be shared with other trees; see own_
+            Vector<std::shared_ptr<Node>> children;
+
+            private:
+                void insertPrefix_(size_type i, const T& elem, std::true_type) {
+                    shiftIn_(prefixes, i, keyTraits::prefix(elem));
+                }
+
+                void insertPrefix_(size_type, const T&, std::false_type) {}
+
+                void setPrefix_(size_type i, const T& elem, std::true_type) {
+                    prefixes[i] = keyTraits::prefix(elem);
+                }
+
+                void setPrefix_(size_type, const T&, std::false_type) {}
+
+                void erasePrefix_(size_type i, std::true_type) {
+                    shiftOut_(prefixes, i);
+                }
+
+                void erasePrefix_(size_type, std::false_type) {}
+
+                void clearPrefixes_(std::true_type) {
+                    prefixes.clear();
+                }
+
+                void clearPrefixes_(std::false_type) {}
+
+                void reservePrefixes_(size_type n, std::true_type) {
+                    prefixes.reserve(n);
+                }
+
+                void reservePrefixes_(size_type, std::false_type) {}
+
+#ifdef BTREE_ELEMENTWISE_SHIFT
+                // everything goes through vector::insert and erase, as it used to, for bench_insert to compare with
+                template <typename U>
+                using Memmovable = std::false_type;
+#else
+                template <typename U>
+                using Memmovable = std::is_trivially_copyable<U>;
+#endif
+
+                /**
+                 * Inserts value at v[i]. Trivially copyable values (longs,
+                 * prefixes) are shifted along with one memmove; anything
+                 * else is left to vector::insert to move one at a time.
+                 */
+                template <typename V, typename U>
+                static void shiftIn_(V& v, size_type i, U&& value) {
+                    shiftIn_(v, i, std::forward<U>(value), Memmovable<typename V::value_type>());
+                }
+
+                template <typename V, typename U>
+                static void shiftIn_(V& v, size_type i, U&& value, std::false_type) {
+                    v.insert(v.begin() + i, std::forward<U>(value));
+                }
+
+                template <typename V, typename U>
+                static void shiftIn_(V& v, size_type i, U&& value, std::true_type) {
+                    // push_back copes with value being in v, and makes room at the end
+                    v.push_back(std::forward<U>(value));
+                    typename V::value_type copy = v.back();
+                    std::memmove(v.data() + i + 1, v.data() + i, (v.size() - 1 - i) * sizeof(copy));
+                    v[i] = copy;
+                }
+
+                // removes v[i], the same way shiftIn_ inserts
+                template <typename V>
+                static void shiftOut_(V& v, size_type i) {
+                    shiftOut_(v, i, Memmovable<typename V::value_type>());
+                }
+
+                template <typename V>
+                static void shiftOut_(V& v, size_type i, std::false_type) {
+                    v.erase(v.begin() + i);
+                }
+
+                template <typename V>
+                static void shiftOut_(V& v, size_type i, std::true_type) {
+                    std::memmove(v.data() + i, v.data() + i + 1, (v.size() - 1 - i) * sizeof(typename V::value_type));
+                    v.pop_back();
+                }
         };
 
-        std::unique_ptr<Node> head;
+        // what nodes are allocated as: padded out if btree_node_alignment asks for it
+        static constexpr std::size_t nodeAlignment = btree_node_alignment<Alloc>::value;
+        struct alignas(nodeAlignment ? nodeAlignment : alignof(Node)) AlignedNode : Node {
+            using Node::Node;
+        };
+        using StoredNode = std::conditional_t<nodeAlignment == 0, Node, AlignedNode>;
+
+        // a node above the current one on the way down, and which of its children was taken
+        struct Step {
+            Node* node;
+            size_type index;
+        };
+        // deep enough for any tree that isn't mostly chains, without allocating
+        using Path = btree_small_vector<Step, 16>;
+
+        // never shared, unlike the nodes below it
+        std::shared_ptr<Node> head;
         size_type maxNodeElems;
+        SearchPolicy searchPolicy;
+        Alloc alloc;
+
+        // emptied nodes kept for reuse, and how many to keep
+        std::vector<std::shared_ptr<Node>> freeNodes;
+        size_type maxFreeNodes = 64;
+
+        using HashIndex = btree_hash_index<Node*>;
+        // where each elem lives, if the hash index is on
+        std::unique_ptr<HashIndex> hashIndex;
+
+        // null unless latency sampling is on
+        std::unique_ptr<btree_latency_recorder> latencyRecorder;
+
+        // whether std::hash<U> works, which the hash index needs
+        template <typename U, typename = void>
+        struct Hashable : std::false_type {};
+        template <typename U>
+        struct Hashable<U, decltype(void(std::hash<U>()(std::declval<const U&>())))> : std::true_type {};
 
         iterator begin_() const {
             if (!head) {
-                return iterator(std::stack<size_type>(), nullptr);
+                return iterator(nullptr, Path(), 0, nullptr);
             }
 
             Node* node = head.get();
-            std::stack<size_type> indices;
+            Path path;
             while (!node->children.empty() && node->children.at(0)) { // node->children.at(0).get() != nullptr
+                pushStep_(path, node, 0);
                 node = node->children.at(0).get();
-                indices.push(0);
             }
-            indices.push(0);
-            return iterator(node, indices);
+            BTREE_COUNT(node_visits, path.size() + 1);
+            return iterator(head.get(), node, 0, std::move(path));
         }
 
         iterator end_() const {
             if (!head) {
-                return iterator(std::stack<size_type>(), nullptr);
+                return iterator(nullptr, Path(), 0, nullptr);
             }
 
             Node* node = head.get();
-            std::stack<size_type> indices;
+            Path path;
 
             // get the size of elems; if there is a child at that index (i.e. something larger than the largest elem), go to that. otherwise take the largest elem.
             while (!node->children.empty() && node->elems.size() == node->children.size() - 1) {
-                indices.push(node->elems.size());
+                pushStep_(path, node, static_cast<size_type>(node->elems.size()));
                 node = node->children.at(node->elems.size()).get();
             }
-            indices.push(node->elems.size() - 1);
-            // does not add extra index to indices
-            return iterator(indices, node);
+            BTREE_COUNT(node_visits, path.size() + 1);
+            // one past the largest elem
+            return iterator(head.get(), std::move(path), node->elems.size() - 1, node);
         }
 
-        iterator find_(const T& elem) const {
+        static void pushStep_(Path& path, Node* node, size_type index) {
+            BTREE_COUNT(path_pushes, 1);
+            path.push_back(Step{node, index});
+        }
+
+        /**
+         * Everything the inserts have in common, in a single trip down the
+         * tree. search(node) finds where the new elem goes in node and
+         * matches(other) says whether other is the same as it. make() hands
+         * over the elem itself, and is only called once we know it's needed.
+         */
+        template <typename Search, typename Matches, typename Make>
+        std::pair<iterator, bool> insert_(Search search, Matches matches, Make make) {
+            btree_latency_recorder::sample timing(latencyRecorder.get(), TimedOp::insert);
+            // whether the elem's going into a node made just for it, which mustn't be left empty
+            bool fresh = !head;
+            if (fresh) {
+                head = newNode_();
+            }
+
+            // look for it, or failing that, the first node with a gap where it goes
             Node* node = head.get();
-            std::stack<size_type> indices;
+            Path path;
             size_type i = 0;
-            while (node != nullptr && i <= node->elems.size()) {
-                if (i == node->elems.size() || elem < node->elems.at(i) ) { // if at end of elems look at final child or if elem is smaller then should look at child to left
-                    // look in that child
-                    if (i >= node->children.size()) {
-                        // no child
+            while (true) {
+                i = search(node);
+                BTREE_COUNT(comparisons, i < node->elems.size());
+                if (i < node->elems.size() && matches(node->elems[i])) {
+                    // already in btree so do nothing
+                    return std::make_pair(iterator(head.get(), node, i, std::move(path)), false);
+                }
+                if (i >= node->children.size() || node->children[i] == nullptr) {
+                    break;
+                }
+                pushStep_(path, node, i);
+                node = node->children[i].get();
+            }
+
+            // we're going to change things, so make the way down ours first
+            node = ownPath_(path);
+
+            // if node saturated add to a new child instead
+            if (node->elems.size() >= maxNodeElems) {
+                if (i >= node->children.size()) {
+                    // extend to fit
+                    node->children.resize(i + 1);
+                }
+                node->children[i] = newNode_();
+                BTREE_COUNT(spills, 1);
+                pushStep_(path, node, i);
+                node = node->children[i].get();
+                i = 0;
+                fresh = true;
+            }
+
+            try {
+                node->insertElem(i, make());
+            } catch (...) {
+                // making or copying the elem threw, so there's nothing to go in the new node
+                if (fresh) {
+                    dropEmpty_(path);
+                }
+                throw;
+            }
+            if (i < node->children.size()) {
+                // the gap we went in had no child, so neither side of the new elem does
+                node->children.insert(node->children.begin() + i, nullptr);
+            }
+            if (hashIndex) {
+                hashIndex->insert(hashOf_(node->elems[i]), node);
+            }
+            return std::make_pair(iterator(head.get(), node, i, std::move(path)), true);
+        }
+
+        iterator find_(const T& elem) const {
+            btree_latency_recorder::sample timing(latencyRecorder.get(), TimedOp::find);
+            const Probe probe = makeProbe_(elem);
+            if (hashIndex) {
+                return hashFind_(probe);
+            }
+
+            Node* node = head.get();
+            Path path;
+            while (node != nullptr) {
+                size_type i = search_(node, probe);
+                BTREE_COUNT(comparisons, i < node->elems.size());
+                if (i < node->elems.size() && node->elems[i] == elem) {
+                    // found
+                    return iterator(head.get(), node, i, std::move(path));
+                }
+                // elem is smaller than the elem at i (or i is past the end) so look in the child to its left
+                if (i >= node->children.size()) {
+                    // no child
+                    return end_();
+                }
+                pushStep_(path, node, i);
+                node = node->children[i].get();
+            }
+            return end_();
+        }
+
+        // an iterator to the first elem that isn't less than elem
+        iterator lowerBound_(const T& elem) const {
+            const Probe probe = makeProbe_(elem);
+            Node* node = head.get();
+            Path path;
+            while (node != nullptr) {
+                size_type i = search_(node, probe);
+                BTREE_COUNT(comparisons, i < node->elems.size());
+                bool found = i < node->elems.size() && node->elems[i] == elem;
+                if (!found && i < node->children.size() && node->children[i]) {
+                    // anything between elems[i - 1] and elems[i] is in the child between them
+                    pushStep_(path, node, i);
+                    node = node->children[i].get();
+                } else if (i < node->elems.size()) {
+                    return iterator(head.get(), node, i, std::move(path));
+                } else {
+                    // everything here is smaller, so it's the first elem we went down to the left of
+                    while (!path.empty() && path.back().index == path.back().node->elems.size()) {
+                        path.pop_back();
+                    }
+                    if (path.empty()) {
                         return end_();
                     }
-                    node = node->children.at(i).get();
-                    indices.push(i);
+                    node = path.back().node;
+                    i = path.back().index;
+                    path.pop_back();
+                    return iterator(head.get(), node, i, std::move(path));
+                }
+            }
+            return end_();
+        }
+
+        /**
+         * Makes sure ptr, a child of a node we're about to change, isn't
+         * shared with another tree, copying it if it is. Returns the node
+         * that's now safe to change.
+         */
+        Node* own_(std::shared_ptr<Node>& ptr) {
+            if (ptr.use_count() > 1) {
+                auto copy = newNode_();
+                *copy = *ptr;
+                rehome_(ptr.get(), copy.get());
+                ptr = std::move(copy);
+            }
+            return ptr.get();
+        }
+
+        /**
+         * own_s every node on path, the way down from the root to some node
+         * we're about to change (the root is never shared, but anything
+         * below it might be). Updates path to match and returns that node.
+         */
+        Node* ownPath_(Path& path) {
+            Node* node = head.get();
+            for (auto& step : path) {
+                step.node = node;
+                node = own_(node->children[step.index]);
+            }
+            return node;
+        }
+
+        // a node off the free list if there are any, else a new one
+        std::shared_ptr<Node> newNode_() {
+            if (freeNodes.empty()) {
+                BTREE_COUNT(allocations, 1);
+                return std::allocate_shared<StoredNode>(alloc, alloc);
+            }
+            BTREE_COUNT(reuses, 1);
+            auto node = std::move(freeNodes.back());
+            freeNodes.pop_back();
+            return node;
+        }
+
+        /**
+         * Lets go of the subtree under node one node at a time. Left to
+         * their destructors, nodes would free their children recursively,
+         * and sorted input builds chains of nodes deep enough for that to
+         * overflow the stack. Nodes something else still shares are just
+         * let go of; recycle puts the rest on the free list.
+         */
+        void release_(std::shared_ptr<Node> node, bool recycle) {
+            std::vector<std::shared_ptr<Node>> pending;
+            if (node) {
+                pending.push_back(std::move(node));
+            }
+            while (!pending.empty()) {
+                auto current = std::move(pending.back());
+                pending.pop_back();
+                if (current.use_count() > 1) {
+                    // dropping our reference won't free it, so nothing below it either
+                    continue;
+                }
+                for (auto& child : current->children) {
+                    if (child) {
+                        pending.push_back(std::move(child));
+                    }
+                }
+                if (recycle) {
+                    retire_(current);
+                }
+            }
+        }
+
+        /**
+         * Takes an emptied node out of ptr, keeping it for reuse, storage
+         * and all, if there's room. ptr is null afterwards even if keeping
+         * the node fails (say the allocator runs out); it's just dropped.
+         */
+        void retire_(std::shared_ptr<Node>& ptr) {
+            std::shared_ptr<Node> node = std::move(ptr);
+            if (freeNodes.size() < maxFreeNodes && node.use_count() == 1) {
+                node->clear();
+                try {
+                    // room for a full node's worth, once, so whatever reuses it never has to grow it
+                    node->reserve(maxNodeElems);
+                    node->children.reserve(maxNodeElems + 1);
+                    freeNodes.push_back(std::move(node));
+                } catch (...) {
+                }
+            }
+        }
+
+        // erase, handing the element to take on its way out
+        template <typename Take>
+        size_type erase_(const T& elem, Take take) {
+            btree_latency_recorder::sample timing(latencyRecorder.get(), TimedOp::erase);
+            const Probe probe = makeProbe_(elem);
+            Node* node = head.get();
+            Path path;
+            size_type i = 0;
+            while (true) {
+                if (node == nullptr) {
+                    return 0;
+                }
+                i = search_(node, probe);
+                BTREE_COUNT(comparisons, i < node->elems.size());
+                if (i < node->elems.size() && node->elems[i] == elem) {
+                    break;
+                }
+                if (i >= node->children.size()) {
+                    return 0;
+                }
+                pushStep_(path, node, i);
+                node = node->children[i].get();
+            }
+
+            node = ownPath_(path);
+            if (hashIndex) {
+                hashIndex->erase(hashOf_(elem), [node](Node* other) { return other == node; });
+            }
+            take(std::move(node->elems[i]));
+            eraseAt_(node, i, path);
+            return 1;
+        }
+
+        /**
+         * Removes node->elems[i], where path leads to node and everything on
+         * it is ours. The gap is filled with the elem next to it from a
+         * child subtree if there is one, which leaves a gap there instead,
+         * and so on down until the gap is in a node with no children either
+         * side of it and can just be closed up.
+         */
+        void eraseAt_(Node* node, size_type i, Path& path) {
+            while (true) {
+                bool leftChild = i < node->children.size() && node->children[i];
+                bool rightChild = i + 1 < node->children.size() && node->children[i + 1];
+                if (!leftChild && !rightChild) {
+                    break;
+                }
+
+                // fill the gap with the largest elem on the left or smallest on the right
+                Node* gap = node;
+                size_type gapIndex = i;
+                pushStep_(path, node, leftChild ? i : i + 1);
+                node = own_(node->children[path.back().index]);
+                if (leftChild) {
+                    while (node->children.size() == node->elems.size() + 1 && node->children.back()) {
+                        pushStep_(path, node, static_cast<size_type>(node->elems.size()));
+                        node = own_(node->children.back());
+                    }
+                    i = node->elems.size() - 1;
+                } else {
+                    while (!node->children.empty() && node->children[0]) {
+                        pushStep_(path, node, 0);
+                        node = own_(node->children[0]);
+                    }
                     i = 0;
-                } else if (node->elems.at(i) == elem) {
-                    // found
-                    indices.push(i);
-                    return iterator(node, indices);
+                }
+                if (hashIndex) {
+                    hashIndex->move(hashOf_(node->elems[i]), [node](Node* other) { return other == node; }, gap);
+                }
+                gap->setElem(gapIndex, std::move(node->elems[i]));
+            }
+
+            // no child either side, so drop one of the two empty child slots along with the elem
+            node->eraseElem(i);
+            if (i + 1 < node->children.size()) {
+                node->children.erase(node->children.begin() + i + 1);
+            } else if (i < node->children.size()) {
+                node->children.erase(node->children.begin() + i);
+            }
+            trimChildren_(node);
+
+            if (node->elems.empty()) {
+                // which leaves it with no children either, so get rid of it
+                dropEmpty_(path);
+            }
+        }
+
+        // takes the empty, childless node path leads to out of the tree
+        void dropEmpty_(const Path& path) {
+            if (path.empty()) {
+                retire_(head);
+            } else {
+                Node* parent = path.back().node;
+                retire_(parent->children[path.back().index]);
+                trimChildren_(parent);
+            }
+        }
+
+        // empty child slots at the end mean nothing, and end_ relies on there being none
+        static void trimChildren_(Node* node) {
+            while (!node->children.empty() && !node->children.back()) {
+                node->children.pop_back();
+            }
+        }
+
+        // tells the hash index the elems in from now live in to
+        void rehome_(Node* from, Node* to) {
+            if (!hashIndex || from == nullptr) {
+                return;
+            }
+            for (const auto& elem : to->elems) {
+                hashIndex->move(hashOf_(elem), [from](Node* node) { return node == from; }, to);
+            }
+        }
+
+        /**
+         * Returns an iterator to node->elems[i]. It works out how to get
+         * there from the root only if it's moved.
+         */
+        iterator iteratorAt_(Node* node, size_type i) const {
+            return iterator(head.get(), node, i);
+        }
+
+        /**
+         * Calls f(node, i) for every elem in the tree, in order, without
+         * recursing (chains of nodes can get very deep).
+         */
+        template <typename F>
+        void forEachInOrder_(F f) const {
+            // each entry is a node and how far through it we are: on even steps
+            // we go down into the child left of elem step / 2, on odd steps we
+            // visit that elem
+            std::vector<std::pair<Node*, size_type>> stack;
+            if (head) {
+                stack.emplace_back(head.get(), 0);
+            }
+            while (!stack.empty()) {
+                Node* node = stack.back().first;
+                size_type step = stack.back().second++;
+                size_type i = step / 2;
+                if (step % 2 == 0) {
+                    if (i < node->children.size() && node->children[i]) {
+                        stack.emplace_back(node->children[i].get(), 0);
+                    }
+                } else if (i < node->elems.size()) {
+                    f(node, i);
                 } else {
-                    ++i;
+                    stack.pop_back();
                 }
             }
-            return end_();
         }
 
-        friend void swap(btree<T>& a, btree<T>& b) {
+        /**
+         * Calls f(node, i) for every elem in the tree, a level at a time
+         * from the root down, each level's nodes and elems left to right.
+         */
+        template <typename F>
+        void forEachBreadthFirst_(F f) const {
+            std::queue<Node*> queue;
+            if (head) {
+                queue.push(head.get());
+            }
+            while (!queue.empty()) {
+                Node* node = queue.front();
+                queue.pop();
+                for (auto& child : node->children) {
+                    if (child) {
+                        queue.push(child.get());
+                    }
+                }
+                for (size_type i = 0; i < node->elems.size(); ++i) {
+                    f(node, i);
+                }
+            }
+        }
+
+        void enableHashIndex_(std::true_type) {
+            buildHashIndex_();
+        }
+
+        // can't be a static_assert: whether it's turned on isn't known until run time
+        void enableHashIndex_(std::false_type) {
+            assert(!"the hash index needs std::hash<T>");
+        }
+
+        void buildHashIndex_() {
+            static_assert(Hashable<T>::value, "the hash index needs std::hash<T>");
+            hashIndex = std::make_unique<HashIndex>();
+            forEachInOrder_([this](Node* node, size_type i) {
+                hashIndex->insert(hashOf_(node->elems[i]), node);
+            });
+        }
+
+        static std::size_t hashOf_(const T& elem) {
+            return hashOf_(elem, Hashable<T>());
+        }
+
+        static std::size_t hashOf_(const T& elem, std::true_type) {
+            return std::hash<T>()(elem);
+        }
+
+        // only here so trees of unhashable things compile; they can't turn the index on
+        static std::size_t hashOf_(const T&, std::false_type) {
+            return 0;
+        }
+
+        // find_ but asking the hash index which node to look in
+        iterator hashFind_(const Probe& probe) const {
+            size_type i = 0;
+            Node* node = hashIndex->find(hashOf_(probe.elem), [&](Node* candidate) {
+                i = search_(candidate, probe);
+                return i < candidate->elems.size() && candidate->elems[i] == probe.elem;
+            });
+            if (node == nullptr) {
+                return end_();
+            }
+            return iteratorAt_(node, i);
+        }
+
+        static Probe makeProbe_(const T& elem) {
+            return makeProbe_(elem, Normalized());
+        }
+
+        static Probe makeProbe_(const T& elem, std::true_type) {
+            return Probe{elem, keyTraits::prefix(elem)};
+        }
+
+        static Probe makeProbe_(const T& elem, std::false_type) {
+            return Probe{elem, NoPrefix()};
+        }
+
+        /**
+         * Returns the index of the first elem in node which is not less than
+         * the probe's elem, i.e. where it is or would be, searching as
+         * searchPolicy says.
+         */
+        size_type search_(const Node* node, const Probe& probe) const {
+            BTREE_COUNT(node_visits, 1);
+            return search_(node, probe, Normalized());
+        }
+
+        size_type search_(const Node* node, const Probe& probe, std::false_type) const {
+            return policySearch_(node->elems, probe.elem);
+        }
+
+        size_type search_(const Node* node, const Probe& probe, std::true_type) const {
+            // find the first elem whose prefix isn't smaller, then break any ties with the elems themselves
+            size_type i = policySearch_(node->prefixes, probe.prefix);
+            while (i < node->elems.size() && node->prefixes[i] == probe.prefix && node->elems[i] < probe.elem) {
+                BTREE_COUNT(comparisons, 2);
+                ++i;
+            }
+            BTREE_COUNT(comparisons, i < node->elems.size());
+            return i;
+        }
+
+        /**
+         * search_ for something that isn't a T but can be compared with one.
+         * Prefixes and interpolation need a T, so this only scans or bisects.
+         */
+        template <typename K>
+        size_type searchKey_(const Node* node, const K& key) const {
+            BTREE_COUNT(node_visits, 1);
+            if (searchPolicy == SearchPolicy::linear) {
+                return linearSearch_(node->elems, key, 0, node->elems.size());
+            }
+            return binarySearch_(node->elems, key, 0, node->elems.size());
+        }
+
+        // searches a node's elems or prefixes as searchPolicy says
+        template <typename K, typename A>
+        size_type policySearch_(const std::vector<K, A>& keys, const K& key) const {
+            switch (searchPolicy) {
+                case SearchPolicy::binary:
+                    return binarySearch_(keys, key, 0, keys.size());
+                case SearchPolicy::interpolation:
+                    return interpolationSearch_(keys, key, std::is_arithmetic<K>());
+                case SearchPolicy::linear:
+                default:
+                    return linearSearch_(keys, key, 0, keys.size());
+            }
+        }
+
+        template <typename E, typename A, typename K>
+        static size_type linearSearch_(const std::vector<E, A>& elems, const K& elem, size_type lo, size_type hi) {
+            size_type start = lo;
+            while (lo < hi && elems[lo] < elem) {
+                ++lo;
+            }
+            // one for each elem passed, and one for the elem it stopped at
+            BTREE_COUNT(comparisons, lo - start + (lo < hi));
+            return lo;
+        }
+
+        template <typename E, typename A, typename K>
+        static size_type binarySearch_(const std::vector<E, A>& elems, const K& elem, size_type lo, size_type hi) {
+            while (lo < hi) {
+                size_type mid = lo + (hi - lo) / 2;
+                BTREE_COUNT(comparisons, 1);
+                if (elems[mid] < elem) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return lo;
+        }
+
+        // can't interpolate between things that aren't numbers
+        template <typename K, typename A>
+        static size_type interpolationSearch_(const std::vector<K, A>& elems, const K& elem, std::false_type) {
+            return binarySearch_(elems, elem, 0, elems.size());
+        }
+
+        template <typename K, typename A>
+        static size_type interpolationSearch_(const std::vector<K, A>& elems, const K& elem, std::true_type) {
+            // ranges this small are quicker to just scan
+            const size_type linearCutoff = 8;
+            size_type lo = 0;
+            size_type hi = elems.size();
+            while (hi - lo > linearCutoff) {
+                // the answer is always somewhere in [lo, hi]
+                BTREE_COUNT(comparisons, 1);
+                if (!(elems[lo] < elem)) {
+                    return lo;
+                }
+                BTREE_COUNT(comparisons, 1);
+                if (elems[hi - 1] < elem) {
+                    return hi;
+                }
+
+                // elems[lo] < elem <= elems[hi - 1], but big enough keys can
+                // still round to the same double, or overflow one
+                double span = static_cast<double>(elems[hi - 1]) - static_cast<double>(elems[lo]);
+                double offset = static_cast<double>(elem) - static_cast<double>(elems[lo]);
+                if (!(span > 0) || !std::isfinite(span) || !std::isfinite(offset)) {
+                    return binarySearch_(elems, elem, lo, hi);
+                }
+                size_type guess = lo + static_cast<size_type>(offset / span * (hi - 1 - lo));
+                if (guess >= hi) {
+                    guess = hi - 1;
+                }
+
+                size_type before = hi - lo;
+                BTREE_COUNT(comparisons, 1);
+                if (elems[guess] < elem) {
+                    lo = guess + 1;
+                } else {
+                    hi = guess;
+                }
+                if ((hi - lo) * 4 > before * 3) {
+                    // the guess barely narrowed things down so the elems
+                    // aren't evenly spread; stop guessing and bisect
+                    return binarySearch_(elems, elem, lo, hi);
+                }
+            }
+            return linearSearch_(elems, elem, lo, hi);
+        }
+
+        // only allocators that propagate get assigned or swapped; some (e.g. pmr's) can't be
+        static void adoptAlloc_(Alloc& ours, const Alloc& theirs, std::true_type) {
+            ours = theirs;
+        }
+
+        static void adoptAlloc_(Alloc&, const Alloc&, std::false_type) {}
+
+        static void swapAllocs_(Alloc& a, Alloc& b, std::true_type) {
+            using std::swap;
+            swap(a, b);
+        }
+
+        static void swapAllocs_(Alloc&, Alloc&, std::false_type) {}
+
+        /**
+         * Swaps everything, allocators included if Alloc says they go with
+         * their nodes. If not, they stay with their trees, so the two have to
+         * compare equal, as for the standard containers; otherwise each tree
+         * would end up with nodes from the other's allocator.
+         */
+        friend void swap(btree& a, btree& b) {
             using std::swap;
+            using Propagate = typename std::allocator_traits<Alloc>::propagate_on_container_swap;
+            assert(Propagate::value || a.alloc == b.alloc);
+            swapAllocs_(a.alloc, b.alloc, Propagate());
             swap(a.head, b.head);
             swap(a.maxNodeElems, b.maxNodeElems);
+            swap(a.searchPolicy, b.searchPolicy);
+            swap(a.hashIndex, b.hashIndex);
+            swap(a.freeNodes, b.freeNodes);
+            swap(a.maxFreeNodes, b.maxFreeNodes);
+            swap(a.latencyRecorder, b.latencyRecorder);
         }
 };
 
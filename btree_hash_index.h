@@ -0,0 +1,154 @@
+/**
+ * An open-addressing hash table from an element to the btree node holding
+ * it, so that point lookups can skip the descent.
+ *
+ * The table doesn't keep copies of the elements. Each entry holds the
+ * element's hash and the node it's in, and callers pass in a matches(node)
+ * predicate which checks whether that node really holds the element being
+ * looked for. Collisions are resolved by linear probing, and erasing shifts
+ * later entries back rather than leaving tombstones, so lookups never get
+ * slower as elements come and go.
+ */
+
+#ifndef BTREE_HASH_INDEX_H
+#define BTREE_HASH_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+template <typename Handle>
+class btree_hash_index {
+    public:
+        using size_type = std::size_t;
+
+        /**
+         * Returns the handle of the node matches says holds the element
+         * hashing to hash, or a default-constructed Handle if none does.
+         */
+        template <typename Matches>
+        Handle find(size_type hash, Matches matches) const {
+            if (entries.empty()) {
+                return Handle();
+            }
+            hash = mix_(hash);
+            for (size_type i = hash & mask_(); entries[i].handle != Handle(); i = (i + 1) & mask_()) {
+                if (entries[i].hash == hash && matches(entries[i].handle)) {
+                    return entries[i].handle;
+                }
+            }
+            return Handle();
+        }
+
+        /**
+         * Records that an element hashing to hash, which isn't in the table
+         * yet, now lives in handle.
+         */
+        void insert(size_type hash, Handle handle) {
+            if ((count + 1) * 2 > entries.size()) {
+                // keep at least half the table empty so probe runs stay short
+                rehash_(entries.empty() ? 16 : entries.size() * 2);
+            }
+            place_(Entry{mix_(hash), handle});
+            ++count;
+        }
+
+        /**
+         * Records that the element hashing to hash, whose entry matches
+         * picks out, has moved to newHandle.
+         */
+        template <typename Matches>
+        void move(size_type hash, Matches matches, Handle newHandle) {
+            Entry* entry = findEntry_(mix_(hash), matches);
+            if (entry != nullptr) {
+                entry->handle = newHandle;
+            }
+        }
+
+        /**
+         * Forgets the element hashing to hash whose entry matches picks out.
+         */
+        template <typename Matches>
+        void erase(size_type hash, Matches matches) {
+            Entry* entry = findEntry_(mix_(hash), matches);
+            if (entry == nullptr) {
+                return;
+            }
+            size_type hole = entry - entries.data();
+            // shift back anything after the hole that would no longer be reachable past it
+            for (size_type i = (hole + 1) & mask_(); entries[i].handle != Handle(); i = (i + 1) & mask_()) {
+                size_type home = entries[i].hash & mask_();
+                bool reachable = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+                if (!reachable) {
+                    entries[hole] = entries[i];
+                    hole = i;
+                }
+            }
+            entries[hole] = Entry{0, Handle()};
+            --count;
+        }
+
+        void clear() {
+            entries.clear();
+            count = 0;
+        }
+
+        size_type size() const {
+            return count;
+        }
+
+    private:
+        struct Entry {
+            size_type hash;
+            Handle handle;
+        };
+
+        size_type mask_() const {
+            return entries.size() - 1;
+        }
+
+        // std::hash is often the identity; spread the bits so nearby keys don't pile up
+        static size_type mix_(size_type hash) {
+            std::uint64_t x = hash;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return static_cast<size_type>(x ^ (x >> 31));
+        }
+
+        template <typename Matches>
+        Entry* findEntry_(size_type hash, Matches matches) {
+            if (entries.empty()) {
+                return nullptr;
+            }
+            for (size_type i = hash & mask_(); entries[i].handle != Handle(); i = (i + 1) & mask_()) {
+                if (entries[i].hash == hash && matches(entries[i].handle)) {
+                    return &entries[i];
+                }
+            }
+            return nullptr;
+        }
+
+        void place_(const Entry& entry) {
+            size_type i = entry.hash & mask_();
+            while (entries[i].handle != Handle()) {
+                i = (i + 1) & mask_();
+            }
+            entries[i] = entry;
+        }
+
+        void rehash_(size_type capacity) {
+            std::vector<Entry> old(capacity, Entry{0, Handle()});
+            old.swap(entries);
+            for (const auto& entry : old) {
+                if (entry.handle != Handle()) {
+                    place_(entry);
+                }
+            }
+        }
+
+        // the table's size is always a power of two
+        std::vector<Entry> entries;
+        size_type count = 0;
+};
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * A memory_resource which hands out cache-line aligned blocks carved from
+ * 2 MB slabs, backed by huge pages where the system allows it, so that a
+ * big tree's nodes sit on a few hundred TLB entries rather than hundreds
+ * of thousands. Use it with pmr::btree (see btree_pmr.h), or to have each
+ * node start on a cache line too, pmr::line_aligned_btree:
+ *
+ *     btree_huge_page_resource resource;
+ *     pmr::line_aligned_btree<long> tree(40, &resource);
+ *
+ * Each slab is got by the first of these that works:
+ *
+ * huge_pages  mmap with MAP_HUGETLB, which needs huge pages reserved
+ *             (vm.nr_hugepages)
+ * transparent an ordinary 2 MB aligned mapping, madvise'd MADV_HUGEPAGE
+ *             so transparent huge pages can back it
+ * aligned     a plain 2 MB aligned allocation, where neither exists
+ *
+ * Freed blocks are kept on a free list for their size and reused; slabs
+ * only go back when the resource is released or destroyed. Blocks bigger
+ * than a quarter of a slab get an allocation of their own.
+ *
+ * Like std::pmr::unsynchronized_pool_resource, it's unsynchronized: trees
+ * on one resource must only be used from one thread at a time.
+ *
+ * Needs C++17.
+ */
+
+#ifndef BTREE_HUGE_PAGES_H
+#define BTREE_HUGE_PAGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "btree.h"
+#include "btree_pmr.h"
+
+class btree_huge_page_resource : public std::pmr::memory_resource {
+    public:
+        static constexpr std::size_t slab_size = std::size_t(2) << 20;
+        static constexpr std::size_t alignment = 64;
+
+        // what a slab ended up backed by; see above
+        enum class backing { huge_pages, transparent, aligned };
+
+        /**
+         * @param hugePages whether to try for huge pages at all; without,
+         *        every slab is just aligned (which is handy for comparing)
+         */
+        explicit btree_huge_page_resource(bool hugePages_ = true): hugePages{hugePages_} {}
+
+        btree_huge_page_resource(const btree_huge_page_resource&) = delete;
+        btree_huge_page_resource& operator=(const btree_huge_page_resource&) = delete;
+
+        ~btree_huge_page_resource() override {
+            release();
+        }
+
+        /**
+         * Gives every slab back at once, whether or not what was allocated
+         * from them has been deallocated.
+         */
+        void release() {
+            for (const auto& slab : slabs) {
+                unmap_(slab);
+            }
+            slabs.clear();
+            freeLists.clear();
+            next = end = nullptr;
+        }
+
+        // how many slabs are backed by how
+        std::size_t slab_count(backing how) const {
+            std::size_t count = 0;
+            for (const auto& slab : slabs) {
+                count += slab.how == how;
+            }
+            return count;
+        }
+
+    private:
+        struct Slab {
+            void* base;
+            backing how;
+        };
+
+        // freed blocks link through their first word
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        static constexpr std::size_t maxBlock = slab_size / 4;
+
+        void* do_allocate(std::size_t bytes, std::size_t align) override {
+            std::size_t size = roundUp_(bytes ? bytes : 1, alignment);
+            if (size > maxBlock || align > alignment) {
+                return ::operator new(size, std::align_val_t(align > alignment ? align : alignment));
+            }
+
+            std::size_t sizeClass = size / alignment;
+            if (sizeClass < freeLists.size() && freeLists[sizeClass] != nullptr) {
+                FreeBlock* block = freeLists[sizeClass];
+                freeLists[sizeClass] = block->next;
+                return block;
+            }
+            if (static_cast<std::size_t>(end - next) < size) {
+                // whatever's left of the current slab is too small to bother with
+                Slab slab = map_();
+                slabs.push_back(slab);
+                next = static_cast<char*>(slab.base);
+                end = next + slab_size;
+            }
+            void* block = next;
+            next += size;
+            return block;
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+            std::size_t size = roundUp_(bytes ? bytes : 1, alignment);
+            if (size > maxBlock || align > alignment) {
+                ::operator delete(p, size, std::align_val_t(align > alignment ? align : alignment));
+                return;
+            }
+
+            std::size_t sizeClass = size / alignment;
+            if (sizeClass >= freeLists.size()) {
+                freeLists.resize(sizeClass + 1, nullptr);
+            }
+            freeLists[sizeClass] = new (p) FreeBlock{freeLists[sizeClass]};
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        static std::size_t roundUp_(std::size_t n, std::size_t multiple) {
+            return (n + multiple - 1) / multiple * multiple;
+        }
+
+        Slab map_() const {
+#ifdef __linux__
+            if (hugePages) {
+#ifdef MAP_HUGETLB
+                void* base = mmap(nullptr, slab_size, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if (base != MAP_FAILED) {
+                    return Slab{base, backing::huge_pages};
+                }
+#endif
+                // transparent huge pages only back 2 MB aligned ranges, so map
+                // twice as much and trim it down to the aligned part
+                void* mapped = mmap(nullptr, 2 * slab_size, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (mapped != MAP_FAILED) {
+                    auto start = reinterpret_cast<std::uintptr_t>(mapped);
+                    auto aligned = roundUp_(start, slab_size);
+                    if (aligned > start) {
+                        munmap(mapped, aligned - start);
+                    }
+                    munmap(reinterpret_cast<void*>(aligned + slab_size), start + slab_size - aligned);
+                    void* base = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+                    madvise(base, slab_size, MADV_HUGEPAGE);
+#endif
+                    return Slab{base, backing::transparent};
+                }
+            }
+#endif
+            return Slab{::operator new(slab_size, std::align_val_t(slab_size)), backing::aligned};
+        }
+
+        static void unmap_(const Slab& slab) {
+#ifdef __linux__
+            if (slab.how != backing::aligned) {
+                munmap(slab.base, slab_size);
+                return;
+            }
+#endif
+            ::operator delete(slab.base, slab_size, std::align_val_t(slab_size));
+        }
+
+        bool hugePages;
+        std::vector<Slab> slabs;
+        // the unused part of the newest slab
+        char* next = nullptr;
+        char* end = nullptr;
+        // freeLists[n] holds freed blocks of n * alignment bytes
+        std::vector<FreeBlock*> freeLists;
+};
+
+/**
+ * A polymorphic_allocator whose btrees pad their nodes out to cache lines
+ * of their own; see btree_node_alignment. Copies made without one get the
+ * default resource, as polymorphic_allocator's do.
+ */
+template <typename T>
+class btree_line_allocator : public std::pmr::polymorphic_allocator<T> {
+    public:
+        using std::pmr::polymorphic_allocator<T>::polymorphic_allocator;
+
+        btree_line_allocator select_on_container_copy_construction() const {
+            return btree_line_allocator();
+        }
+};
+
+template <typename T>
+struct btree_node_alignment<btree_line_allocator<T>>
+    : std::integral_constant<std::size_t, btree_huge_page_resource::alignment> {};
+
+namespace pmr {
+
+template <typename T>
+using line_aligned_btree = ::btree<T, btree_line_allocator<T>>;
+
+}  // namespace pmr
+
+#endif
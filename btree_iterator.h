@@ -2,26 +2,33 @@
 #define BTREE_ITERATOR_H
 
 #include <iterator>
-#include <stack>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-template <typename T> class btree;
-template <typename T> class Node;
+#include "btree_stats.h"
 
-template<typename T>
+template <typename T, typename Alloc> class btree;
+
+template<typename T, typename Alloc = std::allocator<std::remove_const_t<T>>>
 class BTreeIterator {
     public:
         using difference_type = ptrdiff_t;
         using iterator_category = std::bidirectional_iterator_tag;
         using value_type = T;
-        using pointer = T*;
-        using reference = T&;
+        // elements are only ever read through an iterator; see btree.h
+        using pointer = const std::remove_const_t<T>*;
+        using reference = const std::remove_const_t<T>&;
 
         // using size_type = typename btree<T>::size_type;
         using size_type = unsigned int;
-        using Node = typename btree<std::remove_const_t<T>>::Node;
+        using Node = typename btree<std::remove_const_t<T>, Alloc>::Node;
+        using Step = typename btree<std::remove_const_t<T>, Alloc>::Step;
+        using Path = typename btree<std::remove_const_t<T>, Alloc>::Path;
 
         reference operator*() const {
-            return node->elems[indices.top()];
+            return node->elems[index];
         }
 
         pointer operator->() const {
@@ -30,39 +37,39 @@ class BTreeIterator {
 
         // prefix inc
         BTreeIterator& operator++() {
-            // go to leftmost thing that is to the right of the current node
+            // go to leftmost thing that is to the right of the current elem
             // if there is a child to the right (i.e. in index i+1), take the leftmost thing in that subtree
             // else take the elem to the right (i.e. i+1)
             // if no elem or child to the right, take the elem to the right in the parent
             // if no elem to the right in the parent go to the next parent. continue as necessary
-            if (indices.top() + 1 < node->children.size() &&
-                    node->children.at(indices.top() + 1)) {
+            if (index + 1 < node->children.size() && node->children[index + 1]) {
                 // if there is a child to the right, go to it
-                ++indices.top();
-                node = node->children.at(indices.top()).get();
-                indices.push(0);
+                resolvePath_();
+                push_(node, index + 1);
+                node = node->children[index + 1].get();
                 // go to smallest elem in the right subtree
-                while (!node->children.empty() && node->children.at(0)) {
-                    node = node->children.at(0).get();
-                    indices.push(0);
+                while (!node->children.empty() && node->children[0]) {
+                    push_(node, 0);
+                    node = node->children[0].get();
                 }
+                index = 0;
+            } else if (index + 1 < node->elems.size()) {
+                ++index;
             } else {
-                Node* originalNode = node;
-                auto originalIndices = indices;
-                ++indices.top();
-                // go upwards until at valid elem
-                while (indices.top() == node->elems.size()) {
-                    indices.pop();
-                    if (node->parent == nullptr) {
-                        // at end
-                        endParent = originalNode;
-                        node = nullptr;
-                        indices = originalIndices;
-                        // note does not add extra index to indices
-                        break;
-                    }
-                    // go up
-                    node = node->parent;
+                // go upwards until at valid elem, i.e. the first parent we came down left of an elem
+                resolvePath_();
+                auto level = path.size();
+                while (level > 0 && path[level - 1].index == path[level - 1].node->elems.size()) {
+                    --level;
+                }
+                if (level == 0) {
+                    // at end; leave the path alone so we can come back
+                    endParent = node;
+                    node = nullptr;
+                } else {
+                    node = path[level - 1].node;
+                    index = path[level - 1].index;
+                    path.resize(level - 1);
                 }
             }
             return *this;
@@ -81,25 +88,29 @@ class BTreeIterator {
                 // at end
                 node = endParent;
                 endParent = nullptr;
-            } else if (indices.top() < node->children.size() &&
-                    node->children.at(indices.top())) {
+            } else if (index < node->children.size() && node->children[index]) {
                 // if there is a child to the left, go to it
-                node = node->children.at(indices.top()).get();
-                indices.push(node->elems.size() - 1); // be careful of index
+                resolvePath_();
+                push_(node, index);
+                node = node->children[index].get();
                 // go to largest elem in the left subtree
-                while (node->children.size() == node->elems.size() + 1 && node->children.at(node->elems.size())) {
+                while (node->children.size() == node->elems.size() + 1 && node->children[node->elems.size()]) {
                     // while there is a child to the right of the final elem
-                    node = node->children.at(node->elems.size()).get();
-                    indices.push(node->elems.size() - 1);
+                    push_(node, static_cast<size_type>(node->elems.size()));
+                    node = node->children[node->elems.size()].get();
                 }
+                index = node->elems.size() - 1;
+            } else if (index > 0) {
+                --index;
             } else {
-                // go upwards until at valid elem
-                while (indices.top() == 0) {
-                    indices.pop();
-                    // if index is 0, need to go from parent to child again since cant decrement
-                    node = node->parent;
+                // go upwards until at valid elem, i.e. the first parent we came down right of an elem
+                resolvePath_();
+                while (path.back().index == 0) {
+                    path.pop_back();
                 }
-                --indices.top();
+                node = path.back().node;
+                index = path.back().index - 1;
+                path.pop_back();
             }
             return *this;
         }
@@ -112,7 +123,7 @@ class BTreeIterator {
         }
 
         bool operator==(const BTreeIterator& other) const {
-            return node == other.node && indices == other.indices && endParent == other.endParent;
+            return node == other.node && index == other.index && endParent == other.endParent && root == other.root;
         }
 
         bool operator!=(const BTreeIterator& other) const {
@@ -120,29 +131,81 @@ class BTreeIterator {
         }
 
         // casting iterators to const_iterators
-        operator BTreeIterator<const T>() const {
-            return BTreeIterator<const T>(node, indices, endParent);
+        operator BTreeIterator<const T, Alloc>() const {
+            return BTreeIterator<const T, Alloc>(root, node, index, path, pathKnown, endParent);
         }
 
-        BTreeIterator(Node* node_, std::stack<size_type> indices_): BTreeIterator(node_, indices_, nullptr) { }
+        // an iterator to node->elems[index], with the path down to it from root
+        BTreeIterator(Node* root_, Node* node_, size_type index_, Path path_):
+            BTreeIterator(root_, node_, index_, std::move(path_), true, nullptr) { }
 
-        BTreeIterator(std::stack<size_type> indices_, Node* endParent_): node{nullptr}, indices{indices_}, endParent{endParent_} { }
+        // an iterator to node->elems[index] which works out the path from root when it needs it
+        BTreeIterator(Node* root_, Node* node_, size_type index_):
+            BTreeIterator(root_, node_, index_, Path(), node_ == root_, nullptr) { }
 
-        BTreeIterator(Node* node_, std::stack<size_type> indices_, Node* endParent_): node{node_}, indices{indices_}, endParent{endParent_} { }
+        // the end iterator, one past endParent->elems[index]
+        BTreeIterator(Node* root_, Path path_, size_type index_, Node* endParent_):
+            BTreeIterator(root_, nullptr, index_, std::move(path_), true, endParent_) { }
+
+        BTreeIterator(Node* root_, Node* node_, size_type index_, Path path_, bool pathKnown_, Node* endParent_):
+            root{root_}, node{node_}, index{index_}, path(std::move(path_)), pathKnown{pathKnown_}, endParent{endParent_} { }
 
     private:
+        // goes down a level, counting the node we're going down from
+        void push_(Node* from, size_type i) {
+            BTREE_COUNT(path_pushes, 1);
+            BTREE_COUNT(node_visits, 1);
+            path.push_back(Step{from, i});
+        }
+
+        /**
+         * Iterators made straight from a node (e.g. by the hash index) don't
+         * know how they got there. Nodes don't know their parents either,
+         * since copies of a tree share them, so go back down from the root
+         * looking for the current elem.
+         */
+        void resolvePath_() {
+            if (pathKnown) {
+                return;
+            }
+            const auto& elem = node->elems[index];
+            for (Node* current = root; current != node; ) {
+                // the first elem not less than ours; we're in the child to its left
+                size_type lo = 0;
+                size_type hi = current->elems.size();
+                while (lo < hi) {
+                    size_type mid = lo + (hi - lo) / 2;
+                    BTREE_COUNT(comparisons, 1);
+                    if (current->elems[mid] < elem) {
+                        lo = mid + 1;
+                    } else {
+                        hi = mid;
+                    }
+                }
+                push_(current, lo);
+                current = current->children[lo].get();
+            }
+            pathKnown = true;
+        }
+
+        // the root of the tree we're in, the current elem (node is null at
+        // the end) and how we got there
+        Node* root;
         Node* node;
-        std::stack<size_type> indices;
+        size_type index;
+        Path path;
+        bool pathKnown;
+        // at the end, the node of the last elem, so we can step back
         Node* endParent;
 };
 
-template <typename T>
-bool operator==(const BTreeIterator<T>& a, const BTreeIterator<const T>& b) {
-    return static_cast<BTreeIterator<const T>>(a) == b;
+template <typename T, typename Alloc>
+bool operator==(const BTreeIterator<T, Alloc>& a, const BTreeIterator<const T, Alloc>& b) {
+    return static_cast<BTreeIterator<const T, Alloc>>(a) == b;
 }
 
-template <typename T>
-bool operator!=(const BTreeIterator<T>& a, const BTreeIterator<const T>& b) {
+template <typename T, typename Alloc>
+bool operator!=(const BTreeIterator<T, Alloc>& a, const BTreeIterator<const T, Alloc>& b) {
     return !(a == b);
 }
 
@@ -0,0 +1,137 @@
+/**
+ * Key normalization for the btree.
+ *
+ * Comparing std::strings or tuples on the way down the tree means calling
+ * their operator< over and over. A type can opt in to normalization by
+ * specialising btree_key_traits, after which every node also keeps a
+ * fixed-width unsigned prefix of each of its elements, and searches compare
+ * those with plain integer compares. The elements themselves are only
+ * compared when two prefixes tie.
+ *
+ * A normalizer provides
+ *
+ *     static constexpr bool normalized = true;
+ *     using prefix_type = <some unsigned integer type>;
+ *     static prefix_type prefix(const T& elem);
+ *
+ * where prefix must preserve order: prefix(a) < prefix(b) implies a < b.
+ * Equal prefixes say nothing. The normalizers below cover strings, integers
+ * and tuples/pairs of integers, e.g.
+ *
+ *     template <> struct btree_key_traits<std::string> : btree_string_prefix {};
+ *
+ * The specialisation has to be visible before the btree is used, and the same
+ * everywhere in the program.
+ */
+
+#ifndef BTREE_KEY_TRAITS_H
+#define BTREE_KEY_TRAITS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// elements aren't normalized unless someone asks
+template <typename T>
+struct btree_key_traits {
+    static constexpr bool normalized = false;
+};
+
+/**
+ * The first eight bytes of a string, big-endian so that comparing the
+ * integers compares the bytes in order. Shorter strings are padded with
+ * zeros, which is why "ab" and "ab\0" tie and need their strings compared.
+ */
+struct btree_string_prefix {
+    static constexpr bool normalized = true;
+    using prefix_type = std::uint64_t;
+
+    static prefix_type prefix(const std::string& elem) {
+        prefix_type prefix = 0;
+        for (std::size_t i = 0; i < sizeof(prefix_type); ++i) {
+            prefix <<= 8;
+            if (i < elem.size()) {
+                // std::string orders its chars as unsigned chars
+                prefix |= static_cast<unsigned char>(elem[i]);
+            }
+        }
+        return prefix;
+    }
+};
+
+namespace btree_detail {
+
+// an integer's bits as an unsigned number in the same order
+template <typename Int>
+std::uint64_t orderedBits(Int elem) {
+    static_assert(std::is_integral<Int>::value, "only integers can be normalized this way");
+    using Unsigned = std::make_unsigned_t<Int>;
+    std::uint64_t bits = static_cast<Unsigned>(elem);
+    if (std::is_signed<Int>::value) {
+        // flipping the sign bit puts negatives before positives
+        bits ^= std::uint64_t{1} << (sizeof(Int) * 8 - 1);
+    }
+    return bits;
+}
+
+}  // namespace btree_detail
+
+/**
+ * An integer, shifted so that negative numbers come first. Only worth it for
+ * integers inside composite keys; plain integers compare just as fast.
+ */
+template <typename Int>
+struct btree_integer_prefix {
+    static constexpr bool normalized = true;
+    using prefix_type = std::uint64_t;
+
+    static prefix_type prefix(Int elem) {
+        return btree_detail::orderedBits(elem);
+    }
+};
+
+/**
+ * The members of a std::tuple or std::pair of integers packed side by side,
+ * first member in the top bits. Members that don't fit in 64 bits are cut
+ * off, leaving those ties to the tuple's own operator<.
+ */
+template <typename Tuple>
+struct btree_tuple_prefix {
+    static constexpr bool normalized = true;
+    using prefix_type = std::uint64_t;
+
+    static prefix_type prefix(const Tuple& elem) {
+        return pack(elem, std::make_index_sequence<std::tuple_size<Tuple>::value>());
+    }
+
+    private:
+        template <std::size_t... Is>
+        static prefix_type pack(const Tuple& elem, std::index_sequence<Is...>) {
+            prefix_type prefix = 0;
+            unsigned int used = 0;
+            int expand[] = {0, (append(prefix, used, std::get<Is>(elem)), 0)...};
+            (void) expand;
+            if (used == 0) {
+                return 0;
+            }
+            // left align so that what was cut off compares as zeros
+            return used < 64 ? prefix << (64 - used) : prefix;
+        }
+
+        template <typename Int>
+        static void append(prefix_type& prefix, unsigned int& used, Int member) {
+            const unsigned int width = sizeof(Int) * 8;
+            if (used >= 64) {
+                return;
+            }
+            unsigned int take = width < 64 - used ? width : 64 - used;
+            std::uint64_t bits = btree_detail::orderedBits(member) >> (width - take);
+            prefix = take == 64 ? bits : (prefix << take) | bits;
+            used += take;
+        }
+};
+
+#endif
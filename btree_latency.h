@@ -0,0 +1,315 @@
+/**
+ * Latency histograms for a btree's finds, inserts and erases, for seeing
+ * the tail of a live workload rather than its average.
+ *
+ * Turned on with btree::latency_sampling(every), which times one in every
+ * `every` operations each thread does on that tree. Untimed operations
+ * cost finding the thread's shard of the tree's recorder and counting
+ * down in it; timed ones read the TSC (or steady_clock where there's no
+ * TSC) either side. Each thread records into histograms of its own,
+ * behind a lock only latency() and reset_latency() ever contend for, and
+ * btree::latency(op) merges them.
+ *
+ * The histograms are log-bucketed like HDR histograms: exact below 8
+ * ticks, and above that 8 buckets per power of two, so any value read
+ * back is at most 1/8 too high.
+ */
+
+#ifndef BTREE_LATENCY_H
+#define BTREE_LATENCY_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// the operations that get timed
+enum class TimedOp { find, insert, erase };
+
+// what latency(op) reports, in nanoseconds
+struct btree_latency_summary {
+    std::uint64_t count = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double p999 = 0;
+    double max = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const btree_latency_summary& summary) {
+    return os << "count " << summary.count << " p50 " << summary.p50 << "ns p99 " << summary.p99
+              << "ns p999 " << summary.p999 << "ns max " << summary.max << "ns";
+}
+
+// the TSC where there is one, steady_clock where there isn't
+struct btree_latency_clock {
+    // ticks of the clock, whatever it is
+    static std::uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // how fast now() ticks, measured against steady_clock the first time it's needed
+    static double ticksPerNs() {
+#if defined(__x86_64__) || defined(__i386__)
+        static const double rate = [] {
+            auto startTime = std::chrono::steady_clock::now();
+            std::uint64_t startTicks = now();
+            while (std::chrono::steady_clock::now() - startTime < std::chrono::milliseconds(10)) {
+            }
+            std::uint64_t ticks = now() - startTicks;
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+            return ticks / ns;
+        }();
+        return rate;
+#else
+        return 1;
+#endif
+    }
+};
+
+class btree_latency_histogram {
+    public:
+        static constexpr std::size_t subBuckets = 8;
+        static constexpr std::size_t bucketCount = (64 - 2) * subBuckets;
+
+        void record(std::uint64_t ticks) {
+            ++buckets[bucketOf_(ticks)];
+            ++total;
+            if (ticks > highest) {
+                highest = ticks;
+            }
+        }
+
+        void merge(const btree_latency_histogram& other) {
+            for (std::size_t i = 0; i < bucketCount; ++i) {
+                buckets[i] += other.buckets[i];
+            }
+            total += other.total;
+            if (other.highest > highest) {
+                highest = other.highest;
+            }
+        }
+
+        std::uint64_t count() const {
+            return total;
+        }
+
+        std::uint64_t max() const {
+            return highest;
+        }
+
+        // percentiles in nanoseconds, taking the values recorded to be ticks of btree_latency_clock
+        btree_latency_summary summary() const {
+            btree_latency_summary summary;
+            double nsPerTick = 1 / btree_latency_clock::ticksPerNs();
+            summary.count = total;
+            summary.p50 = percentile(0.5) * nsPerTick;
+            summary.p99 = percentile(0.99) * nsPerTick;
+            summary.p999 = percentile(0.999) * nsPerTick;
+            summary.max = highest * nsPerTick;
+            return summary;
+        }
+
+        // the smallest value at least a fraction q of the recorded ones are no bigger than
+        std::uint64_t percentile(double q) const {
+            std::uint64_t wanted = static_cast<std::uint64_t>(q * total + 0.5);
+            if (wanted == 0) {
+                wanted = 1;
+            }
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < bucketCount; ++i) {
+                seen += buckets[i];
+                if (seen >= wanted) {
+                    std::uint64_t top = highestIn_(i);
+                    return top < highest ? top : highest;
+                }
+            }
+            return highest;
+        }
+
+    private:
+        static std::size_t bucketOf_(std::uint64_t value) {
+            if (value < subBuckets) {
+                return static_cast<std::size_t>(value);
+            }
+            std::size_t exponent = 63 - __builtin_clzll(value);
+            std::size_t sub = (value >> (exponent - 3)) & (subBuckets - 1);
+            return (exponent - 2) * subBuckets + sub;
+        }
+
+        static std::uint64_t highestIn_(std::size_t bucket) {
+            if (bucket < subBuckets) {
+                return bucket;
+            }
+            std::size_t exponent = bucket / subBuckets + 2;
+            std::uint64_t sub = bucket % subBuckets;
+            std::uint64_t width = std::uint64_t(1) << (exponent - 3);
+            return ((subBuckets + sub) << (exponent - 3)) + width - 1;
+        }
+
+        std::array<std::uint64_t, bucketCount> buckets{};
+        std::uint64_t total = 0;
+        std::uint64_t highest = 0;
+};
+
+/**
+ * Owned by a btree with sampling on. Each thread gets its own histograms
+ * the first time it's timed, and only ever writes to those.
+ */
+class btree_latency_recorder {
+        struct Shard;
+
+    public:
+        explicit btree_latency_recorder(unsigned every_): every{every_}, id{nextId_()++} {}
+
+        btree_latency_recorder(const btree_latency_recorder&) = delete;
+        btree_latency_recorder& operator=(const btree_latency_recorder&) = delete;
+
+        unsigned sampling() const {
+            return every;
+        }
+
+        /**
+         * Times from construction to destruction if this is one of the
+         * operations to be sampled; does nothing if recorder is null.
+         */
+        class sample {
+            public:
+                sample(btree_latency_recorder* recorder, TimedOp op_): shard{nullptr}, op{op_}, start{0} {
+                    if (recorder == nullptr) {
+                        return;
+                    }
+                    Shard& mine = recorder->shard_();
+                    if (mine.countdown > 0) {
+                        --mine.countdown;
+                        return;
+                    }
+                    mine.countdown = recorder->every - 1;
+                    shard = &mine;
+                    start = btree_latency_clock::now();
+                }
+
+                sample(const sample&) = delete;
+                sample& operator=(const sample&) = delete;
+
+                ~sample() {
+                    if (shard != nullptr) {
+                        std::uint64_t stop = btree_latency_clock::now();
+                        shard->record(op, stop - start);
+                    }
+                }
+
+            private:
+                Shard* shard;
+                TimedOp op;
+                std::uint64_t start;
+        };
+
+        // everything every thread has recorded for op
+        btree_latency_summary summary(TimedOp op) const {
+            btree_latency_histogram merged;
+            std::lock_guard<std::mutex> lock(shardsMutex);
+            for (const auto& shard : shards) {
+                std::lock_guard<std::mutex> shardLock(shard->mutex);
+                merged.merge(shard->histograms[static_cast<std::size_t>(op)]);
+            }
+            return merged.summary();
+        }
+
+        void reset() {
+            std::lock_guard<std::mutex> lock(shardsMutex);
+            for (auto& shard : shards) {
+                std::lock_guard<std::mutex> shardLock(shard->mutex);
+                shard->histograms = Histograms();
+            }
+        }
+
+    private:
+        using Histograms = std::array<btree_latency_histogram, 3>;
+
+        /**
+         * One thread's histograms; the mutex is only ever contended by
+         * summary and reset. countdown is how many of the thread's
+         * operations to skip before timing the next one, and only the
+         * thread touches it.
+         */
+        struct Shard {
+            std::mutex mutex;
+            Histograms histograms;
+            unsigned countdown = 0;
+
+            void record(TimedOp op, std::uint64_t ticks) {
+                std::lock_guard<std::mutex> lock(mutex);
+                histograms[static_cast<std::size_t>(op)].record(ticks);
+            }
+        };
+
+        /**
+         * The calling thread's shard. Each thread remembers its shards of
+         * the last few recorders it used, so a thread going back and forth
+         * between a handful of trees usually finds its shard in a few
+         * comparisons.
+         */
+        Shard& shard_() {
+            struct Entry {
+                std::uint64_t owner = 0;
+                Shard* shard = nullptr;
+            };
+            struct Cache {
+                std::array<Entry, 4> entries;
+                std::size_t next = 0;
+            };
+            static thread_local Cache cache;
+            for (const auto& entry : cache.entries) {
+                if (entry.owner == id) {
+                    return *entry.shard;
+                }
+            }
+            Shard* found = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(shardsMutex);
+                auto self = std::this_thread::get_id();
+                for (std::size_t i = 0; i < shards.size(); ++i) {
+                    if (threads[i] == self) {
+                        found = shards[i].get();
+                    }
+                }
+                if (found == nullptr) {
+                    shards.push_back(std::make_unique<Shard>());
+                    threads.push_back(self);
+                    found = shards.back().get();
+                }
+            }
+            cache.entries[cache.next] = Entry{id, found};
+            cache.next = (cache.next + 1) % cache.entries.size();
+            return *found;
+        }
+
+        // recorders are told apart by ids that are never reused, unlike addresses
+        static std::atomic<std::uint64_t>& nextId_() {
+            static std::atomic<std::uint64_t> next{1};
+            return next;
+        }
+
+        unsigned every;
+        std::uint64_t id;
+        mutable std::mutex shardsMutex;
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::vector<std::thread::id> threads;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/**
+ * A learned index over a read-only snapshot of a btree of numbers.
+ *
+ * Instead of searching down from the root, a lookup asks a piecewise-linear
+ * model where in sorted order the key should be. Each segment of the model
+ * is fitted so that its guess is never more than maxError places out, so
+ * only that small window of a flat array of the keys needs searching. The
+ * array holds where each key lives in the tree, so the answer is still an
+ * ordinary btree iterator.
+ *
+ * The index keeps its own copy of the tree it was built from, so changing
+ * the original afterwards is fine. The copy can't be changed.
+ */
+
+#ifndef BTREE_LEARNED_H
+#define BTREE_LEARNED_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "btree.h"
+
+template <typename T>
+class btree_learned_index {
+    static_assert(std::is_arithmetic<T>::value, "only trees of numbers can have a learned index");
+
+    public:
+        using const_iterator = typename btree<T>::const_iterator;
+        using size_type = std::size_t;
+
+        /**
+         * Takes a snapshot of tree and fits the model to it.
+         *
+         * @param tree the tree to index
+         * @param maxError how far out a segment's guess may be. Smaller
+         *        means more segments but less searching once we're there.
+         */
+        explicit btree_learned_index(const btree<T>& tree, size_type maxError_ = 32)
+            : snapshot{tree}, maxError{maxError_} {
+            snapshot.forEachInOrder_([this](Node* node, typename btree<T>::size_type i) {
+                keys.push_back(node->elems[i]);
+                slots.emplace_back(node, i);
+            });
+            fit_();
+        }
+
+        // handles point into our own snapshot, so copies would point into the wrong tree
+        btree_learned_index(const btree_learned_index&) = delete;
+        btree_learned_index& operator=(const btree_learned_index&) = delete;
+        btree_learned_index(btree_learned_index&&) = default;
+        btree_learned_index& operator=(btree_learned_index&&) = default;
+
+        /**
+         * Same as btree<T>::find on the snapshot.
+         */
+        const_iterator find(const T& elem) const {
+            if (keys.empty() || elem < keys.front() || keys.back() < elem) {
+                return snapshot.end();
+            }
+
+            // the last segment starting at or before elem
+            auto segment = std::upper_bound(segments.begin(), segments.end(), elem,
+                    [](const T& e, const Segment& s) { return e < s.firstKey; }) - 1;
+            size_type lo = segment->firstRank;
+            size_type hi = (segment + 1 == segments.end()) ? keys.size() : (segment + 1)->firstRank;
+
+            // only look around the guess; the extra one covers rounding
+            double guess = segment->firstRank +
+                segment->slope * (static_cast<double>(elem) - static_cast<double>(segment->firstKey));
+            double windowLo = guess - static_cast<double>(maxError) - 1;
+            double windowHi = guess + static_cast<double>(maxError) + 2;
+            if (windowLo > static_cast<double>(lo)) {
+                lo = std::min(hi, static_cast<size_type>(windowLo));
+            }
+            if (windowHi < static_cast<double>(hi)) {
+                hi = std::max(lo, static_cast<size_type>(windowHi));
+            }
+
+            auto it = std::lower_bound(keys.begin() + lo, keys.begin() + hi, elem);
+            if (it == keys.begin() + hi || !(*it == elem)) {
+                return snapshot.end();
+            }
+            const auto& slot = slots[it - keys.begin()];
+            return static_cast<const_iterator>(snapshot.iteratorAt_(slot.first, slot.second));
+        }
+
+        const_iterator begin() const {
+            return snapshot.begin();
+        }
+
+        const_iterator end() const {
+            return snapshot.end();
+        }
+
+        // the snapshot being indexed
+        const btree<T>& tree() const {
+            return snapshot;
+        }
+
+        // how many linear pieces the model needed
+        size_type segmentCount() const {
+            return segments.size();
+        }
+
+    private:
+        using Node = typename btree<T>::Node;
+
+        struct Segment {
+            T firstKey;
+            size_type firstRank;
+            double slope;
+        };
+
+        /**
+         * Greedily grows each segment for as long as one line can pass
+         * within maxError of every key in it (the "shrinking cone").
+         */
+        void fit_() {
+            size_type start = 0;
+            while (start < keys.size()) {
+                double x0 = static_cast<double>(keys[start]);
+                double slopeLo = 0;
+                double slopeHi = std::numeric_limits<double>::infinity();
+                size_type end = start + 1;
+                for (; end < keys.size(); ++end) {
+                    double dx = static_cast<double>(keys[end]) - x0;
+                    double dy = static_cast<double>(end - start);
+                    if (dx <= 0 || dy / dx < slopeLo || dy / dx > slopeHi) {
+                        // this key can't be reached from the cone so far
+                        break;
+                    }
+                    slopeLo = std::max(slopeLo, (dy - maxError) / dx);
+                    slopeHi = std::min(slopeHi, (dy + maxError) / dx);
+                }
+                // any slope inside the cone is within maxError of every key; a lone key needs none
+                double slope = std::isfinite(slopeHi) ? (slopeLo + slopeHi) / 2 : 0;
+                segments.push_back(Segment{keys[start], start, slope});
+                start = end;
+            }
+        }
+
+        btree<T> snapshot;
+        size_type maxError;
+        std::vector<T> keys;
+        std::vector<std::pair<Node*, typename btree<T>::size_type>> slots;
+        std::vector<Segment> segments;
+};
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * btrees whose nodes (and the elems and children stored in them) are
+ * allocated from a std::pmr::memory_resource, e.g. a per-request
+ * std::pmr::monotonic_buffer_resource that is released all at once:
+ *
+ *     std::pmr::monotonic_buffer_resource resource;
+ *     pmr::btree<long> tree(40, &resource);
+ *
+ * The elements themselves only use the resource if they're allocator
+ * aware and built with it, e.g. std::pmr::string.
+ *
+ * Copies on the same resource share nodes with the tree they were copied
+ * from until one of them writes to a node. A copy onto a different
+ * resource copies every node into that resource, so it can outlive the
+ * resource its original allocated from.
+ *
+ * Like the std::pmr containers, a tree keeps its resource for good. Moving
+ * one tree onto another with a different resource copies the elements
+ * into nodes from the destination's resource, and swapping two trees needs
+ * them to have the same one.
+ *
+ * Needs C++17.
+ */
+
+#ifndef BTREE_PMR_H
+#define BTREE_PMR_H
+
+#include <memory_resource>
+
+#include "btree.h"
+
+namespace pmr {
+
+template <typename T>
+using btree = ::btree<T, std::pmr::polymorphic_allocator<T>>;
+
+}  // namespace pmr
+
+#endif
@@ -0,0 +1,266 @@
+/**
+ * An adaptive radix routing layer over a read-only snapshot of a
+ * btree<std::string>.
+ *
+ * Going down a deep string tree compares the same leading bytes over and
+ * over. Here the upper levels are replaced by a radix tree over the keys'
+ * leading bytes which routes each lookup straight to a small group of
+ * neighbouring keys (at most a node's worth). Only keys inside that group
+ * are ever compared as strings, and only from the byte where they start to
+ * differ.
+ *
+ * Radix nodes pick their layout from how many children they have, as in an
+ * adaptive radix tree: up to 4 or 16 children are found by scanning a few
+ * key bytes, up to 48 through a 256-entry byte map, and anything bigger is
+ * indexed by the byte directly. Runs of bytes every key below a node
+ * shares are stored once in the node rather than as a chain of nodes.
+ *
+ * Like btree_learned_index, the index keeps its own copy of the tree, so it
+ * is a read-only snapshot: changes to the tree after the index is built are
+ * not seen through it. Build a new index to pick them up.
+ */
+
+#ifndef BTREE_RADIX_H
+#define BTREE_RADIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "btree.h"
+
+class btree_radix_index {
+    public:
+        using const_iterator = btree<std::string>::const_iterator;
+        using size_type = std::size_t;
+
+        /**
+         * Takes a snapshot of tree and builds the radix layer over it.
+         *
+         * @param tree the tree to index
+         * @param maxGroupSize how many keys one lookup may have to compare
+         *        against; defaults to the tree's own node size, and is
+         *        at least 1 even if that's 0
+         */
+        explicit btree_radix_index(const btree<std::string>& tree, size_type maxGroupSize_ = 0)
+            : snapshot{tree},
+              maxGroupSize{std::max<size_type>(1, maxGroupSize_ ? maxGroupSize_ : tree.maxNodeElems)} {
+            snapshot.forEachInOrder_([this](Node* node, btree<std::string>::size_type i) {
+                keys.push_back(&node->elems[i]);
+                slots.emplace_back(node, i);
+            });
+            if (!keys.empty()) {
+                root = build_(0, keys.size(), 0);
+            }
+        }
+
+        // handles point into our own snapshot, so copies would point into the wrong tree
+        btree_radix_index(const btree_radix_index&) = delete;
+        btree_radix_index& operator=(const btree_radix_index&) = delete;
+        btree_radix_index(btree_radix_index&&) = default;
+        btree_radix_index& operator=(btree_radix_index&&) = default;
+
+        /**
+         * Same as btree<std::string>::find on the snapshot.
+         */
+        const_iterator find(const std::string& elem) const {
+            if (root < 0) {
+                return snapshot.end();
+            }
+
+            int32_t current = root;
+            size_type depth = 0;
+            while (true) {
+                const RadixNode& node = nodes[current];
+                // every key below here starts with the node's prefix
+                if (elem.compare(depth, node.prefix.size(), node.prefix) != 0) {
+                    return snapshot.end();
+                }
+                depth += node.prefix.size();
+
+                if (node.kind == Kind::leaf) {
+                    return findInGroup_(elem, depth, node.lo, node.hi);
+                }
+                if (elem.size() == depth) {
+                    // elem ends here; only the key ending here can match
+                    if (node.terminal < 0) {
+                        return snapshot.end();
+                    }
+                    current = node.terminal;
+                    continue;
+                }
+                current = child_(node, static_cast<unsigned char>(elem[depth]));
+                if (current < 0) {
+                    return snapshot.end();
+                }
+                ++depth;
+            }
+        }
+
+        const_iterator begin() const {
+            return snapshot.begin();
+        }
+
+        const_iterator end() const {
+            return snapshot.end();
+        }
+
+        // the snapshot being indexed
+        const btree<std::string>& tree() const {
+            return snapshot;
+        }
+
+        // how many radix nodes (including leaf groups) were needed
+        size_type nodeCount() const {
+            return nodes.size();
+        }
+
+    private:
+        using Node = btree<std::string>::Node;
+
+        enum class Kind : unsigned char { leaf, node4, node16, node48, node256 };
+
+        struct RadixNode {
+            Kind kind;
+            // bytes shared by every key below this node, past the byte that led here
+            std::string prefix;
+            // node4/node16: sorted key bytes, parallel to children
+            std::vector<unsigned char> keyBytes;
+            // node48: for each byte, one more than its slot in children (0 if none)
+            std::vector<unsigned char> childSlots;
+            // node256: indexed by byte, -1 if none
+            std::vector<int32_t> children;
+            // the node for the key which ends at this node's depth, if any
+            int32_t terminal = -1;
+            // leaf: the group of keys [lo, hi)
+            size_type lo = 0;
+            size_type hi = 0;
+        };
+
+        /**
+         * Builds the node for the sorted keys [lo, hi), all of which agree
+         * on their first depth bytes, and returns its index.
+         */
+        int32_t build_(size_type lo, size_type hi, size_type depth) {
+            int32_t index = static_cast<int32_t>(nodes.size());
+            nodes.emplace_back();
+
+            // since the keys are sorted, what the whole range shares is what its ends share
+            const std::string& first = *keys[lo];
+            const std::string& last = *keys[hi - 1];
+            size_type shared = depth;
+            while (shared < first.size() && shared < last.size() && first[shared] == last[shared]) {
+                ++shared;
+            }
+
+            if (hi - lo <= maxGroupSize) {
+                nodes[index].kind = Kind::leaf;
+                nodes[index].prefix = first.substr(depth, shared - depth);
+                nodes[index].lo = lo;
+                nodes[index].hi = hi;
+                return index;
+            }
+            nodes[index].prefix = first.substr(depth, shared - depth);
+            depth = shared;
+
+            // a key that ends here sorts before everything that carries on
+            if (keys[lo]->size() == depth) {
+                int32_t terminal = build_(lo, lo + 1, depth);
+                nodes[index].terminal = terminal;
+                ++lo;
+            }
+
+            // split the rest by their next byte
+            std::vector<std::pair<unsigned char, int32_t>> children;
+            while (lo < hi) {
+                unsigned char byte = static_cast<unsigned char>((*keys[lo])[depth]);
+                size_type end = lo + 1;
+                while (end < hi && static_cast<unsigned char>((*keys[end])[depth]) == byte) {
+                    ++end;
+                }
+                children.emplace_back(byte, build_(lo, end, depth + 1));
+                lo = end;
+            }
+            setChildren_(nodes[index], children);
+            return index;
+        }
+
+        // lays out a node's children in the smallest layout that fits them
+        static void setChildren_(RadixNode& node, const std::vector<std::pair<unsigned char, int32_t>>& children) {
+            if (children.size() <= 16) {
+                node.kind = children.size() <= 4 ? Kind::node4 : Kind::node16;
+                for (const auto& child : children) {
+                    node.keyBytes.push_back(child.first);
+                    node.children.push_back(child.second);
+                }
+            } else if (children.size() <= 48) {
+                node.kind = Kind::node48;
+                node.childSlots.assign(256, 0);
+                for (const auto& child : children) {
+                    node.children.push_back(child.second);
+                    node.childSlots[child.first] = static_cast<unsigned char>(node.children.size());
+                }
+            } else {
+                node.kind = Kind::node256;
+                node.children.assign(256, -1);
+                for (const auto& child : children) {
+                    node.children[child.first] = child.second;
+                }
+            }
+        }
+
+        // the child of node for byte, or -1 if there's none
+        static int32_t child_(const RadixNode& node, unsigned char byte) {
+            switch (node.kind) {
+                case Kind::node4:
+                case Kind::node16:
+                    for (size_type i = 0; i < node.keyBytes.size(); ++i) {
+                        if (node.keyBytes[i] == byte) {
+                            return node.children[i];
+                        }
+                    }
+                    return -1;
+                case Kind::node48:
+                    return node.childSlots[byte] ? node.children[node.childSlots[byte] - 1] : -1;
+                case Kind::node256:
+                    return node.children[byte];
+                case Kind::leaf:
+                default:
+                    return -1;
+            }
+        }
+
+        /**
+         * Binary searches the group [lo, hi) for elem. Everything in the
+         * group already matches elem's first depth bytes, so only the rest
+         * is compared.
+         */
+        const_iterator findInGroup_(const std::string& elem, size_type depth, size_type lo, size_type hi) const {
+            while (lo < hi) {
+                size_type mid = lo + (hi - lo) / 2;
+                int comparison = keys[mid]->compare(depth, std::string::npos, elem, depth, std::string::npos);
+                if (comparison == 0) {
+                    return static_cast<const_iterator>(snapshot.iteratorAt_(slots[mid].first, slots[mid].second));
+                }
+                if (comparison < 0) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return snapshot.end();
+        }
+
+        btree<std::string> snapshot;
+        size_type maxGroupSize;
+        // every key in order, pointing into the snapshot, and where each one lives
+        std::vector<const std::string*> keys;
+        std::vector<std::pair<Node*, btree<std::string>::size_type>> slots;
+        std::vector<RadixNode> nodes;
+        int32_t root = -1;
+};
+
+#endif
@@ -0,0 +1,59 @@
+/**
+ * What btree::shape_report() finds out about a tree's shape. Nodes never
+ * split, so the shape depends entirely on the order things went in: sorted
+ * input makes a chain of full nodes each hanging off the last, and lookups
+ * get slower the longer it gets. The report is one walk over the nodes
+ * (none of the elems are looked at), so it's cheap enough to take now and
+ * then on a live tree.
+ */
+
+#ifndef BTREE_SHAPE_H
+#define BTREE_SHAPE_H
+
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+struct btree_shape {
+    // how full the nodes on one level are
+    struct level {
+        std::size_t nodes = 0;
+        std::size_t elems = 0;
+        // fill[i] is how many nodes are between i and i + 1 tenths full (fill[9] includes full ones)
+        std::array<std::size_t, 10> fill{};
+    };
+
+    std::size_t max_node_elems = 0;
+    std::size_t node_count = 0;
+    std::size_t elem_count = 0;
+    // levels, counting the root's as 1; 0 for an empty tree
+    std::size_t height = 0;
+    // levels[0] is the root's level
+    std::vector<level> levels;
+    // the child index taken at each step down the longest root-to-leaf path
+    std::vector<std::size_t> longest_path;
+    // how deep the shallowest and deepest nodes with no children are, the root being depth 0
+    std::size_t min_leaf_depth = 0;
+    std::size_t max_leaf_depth = 0;
+    // the most nodes in a row which each have just the one child
+    std::size_t longest_chain = 0;
+};
+
+// a summary line, then one line per level
+inline std::ostream& operator<<(std::ostream& os, const btree_shape& shape) {
+    os << "nodes " << shape.node_count << " elems " << shape.elem_count << " height " << shape.height
+       << " leaf depth " << shape.min_leaf_depth << "-" << shape.max_leaf_depth
+       << " longest chain " << shape.longest_chain << "\n";
+    for (std::size_t depth = 0; depth < shape.levels.size(); ++depth) {
+        const auto& level = shape.levels[depth];
+        os << "level " << depth << ": " << level.nodes << " nodes " << level.elems << " elems fill";
+        for (auto count : level.fill) {
+            os << " " << count;
+        }
+        os << "\n";
+    }
+    return os;
+}
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * A vector of trivially copyable things which keeps the first N of them
+ * inside itself, and only goes to the heap for more. The btree's paths
+ * from the root down to a node are kept in these, so finds, inserts,
+ * erases and the iterators they return don't allocate for trees up to N
+ * levels deep, which covers everything but chains grown from sorted input.
+ *
+ * Only what the paths need of std::vector is here.
+ */
+
+#ifndef BTREE_SMALL_VECTOR_H
+#define BTREE_SMALL_VECTOR_H
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+template <typename T, std::size_t N>
+class btree_small_vector {
+    static_assert(std::is_trivially_copyable<T>::value, "items are copied about with memcpy");
+
+    public:
+        using value_type = T;
+        using size_type = std::size_t;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        btree_small_vector() = default;
+
+        btree_small_vector(const btree_small_vector& other) {
+            assign_(other);
+        }
+
+        btree_small_vector(btree_small_vector&& other) noexcept {
+            steal_(other);
+        }
+
+        btree_small_vector& operator=(const btree_small_vector& other) {
+            if (this != &other) {
+                count = 0;
+                assign_(other);
+            }
+            return *this;
+        }
+
+        btree_small_vector& operator=(btree_small_vector&& other) noexcept {
+            if (this != &other) {
+                release_();
+                steal_(other);
+            }
+            return *this;
+        }
+
+        ~btree_small_vector() {
+            release_();
+        }
+
+        void push_back(const T& item) {
+            if (count == capacity) {
+                grow_(capacity * 2);
+            }
+            items[count++] = item;
+        }
+
+        void pop_back() {
+            --count;
+        }
+
+        // only ever shrinks, as the iterator uses it
+        void resize(size_type n) {
+            if (n > capacity) {
+                grow_(n);
+            }
+            count = n;
+        }
+
+        void clear() {
+            count = 0;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        size_type size() const {
+            return count;
+        }
+
+        T& operator[](size_type i) {
+            return items[i];
+        }
+
+        const T& operator[](size_type i) const {
+            return items[i];
+        }
+
+        T& back() {
+            return items[count - 1];
+        }
+
+        const T& back() const {
+            return items[count - 1];
+        }
+
+        iterator begin() {
+            return items;
+        }
+
+        iterator end() {
+            return items + count;
+        }
+
+        const_iterator begin() const {
+            return items;
+        }
+
+        const_iterator end() const {
+            return items + count;
+        }
+
+    private:
+        bool onHeap_() const {
+            return items != inlineItems;
+        }
+
+        void grow_(size_type n) {
+            T* bigger = new T[n];
+            std::memcpy(bigger, items, count * sizeof(T));
+            release_();
+            items = bigger;
+            capacity = n;
+        }
+
+        void release_() {
+            if (onHeap_()) {
+                delete[] items;
+                items = inlineItems;
+                capacity = N;
+            }
+        }
+
+        // copies other's items into ours, which are empty
+        void assign_(const btree_small_vector& other) {
+            if (other.count > capacity) {
+                grow_(other.count);
+            }
+            std::memcpy(items, other.items, other.count * sizeof(T));
+            count = other.count;
+        }
+
+        // takes other's heap storage if it has some, else copies; ours is inline
+        void steal_(btree_small_vector& other) {
+            if (other.onHeap_()) {
+                items = other.items;
+                capacity = other.capacity;
+                other.items = other.inlineItems;
+                other.capacity = N;
+            } else {
+                std::memcpy(items, other.items, other.count * sizeof(T));
+            }
+            count = other.count;
+            other.count = 0;
+        }
+
+        T inlineItems[N];
+        T* items = inlineItems;
+        size_type count = 0;
+        size_type capacity = N;
+};
+
+#endif
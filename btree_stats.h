@@ -0,0 +1,60 @@
+/**
+ * Operation counters for finding out where a workload's time goes.
+ *
+ * Counting is compiled in only when BTREE_STATS is defined before btree.h
+ * is first included (e.g. -DBTREE_STATS); otherwise every BTREE_COUNT is
+ * nothing at all, and the counts stay zero. Like NDEBUG, it has to be set
+ * the same way for the whole program: btree's member functions are inline,
+ * so translation units that disagree give two definitions of the same
+ * function, and the linker keeps whichever it likes without a word. Pass
+ * -DBTREE_STATS to every compile, or to none. Each thread counts for itself,
+ * across every btree it uses, so counting needs no synchronisation. Take
+ * snapshots with btree<T>::stats() and subtract them to see what happened
+ * in between.
+ */
+
+#ifndef BTREE_STATS_H
+#define BTREE_STATS_H
+
+#include <cstdint>
+
+struct btree_stats {
+    // elems (or their prefixes) compared with <, or with == to confirm a match
+    std::uint64_t comparisons = 0;
+    // nodes searched or passed through on the way down or along
+    std::uint64_t node_visits = 0;
+    // steps pushed onto a path, by the tree or by iterators
+    std::uint64_t path_pushes = 0;
+    // new children made for a full node; nodes here never split, they spill
+    std::uint64_t spills = 0;
+    // nodes allocated
+    std::uint64_t allocations = 0;
+    // nodes taken off the free list instead of being allocated
+    std::uint64_t reuses = 0;
+
+    // the calling thread's running counts
+    static btree_stats& local() {
+        static thread_local btree_stats counts;
+        return counts;
+    }
+};
+
+inline btree_stats operator-(const btree_stats& a, const btree_stats& b) {
+    btree_stats difference;
+    difference.comparisons = a.comparisons - b.comparisons;
+    difference.node_visits = a.node_visits - b.node_visits;
+    difference.path_pushes = a.path_pushes - b.path_pushes;
+    difference.spills = a.spills - b.spills;
+    difference.allocations = a.allocations - b.allocations;
+    difference.reuses = a.reuses - b.reuses;
+    return difference;
+}
+
+#ifdef BTREE_STATS
+#define BTREE_COUNT(counter, n) (btree_stats::local().counter += (n))
+#else
+// n is still "used", just never evaluated, so nothing counted goes unused
+#define BTREE_COUNT(counter, n) ((void)sizeof(n))
+#endif
+
+#endif
@@ -0,0 +1,323 @@
+/**
+ * Recording what's done to a btree, so it can be done again elsewhere.
+ *
+ * btree_trace_recorder stands in front of a tree and writes each insert,
+ * find, scan and erase made through it to a stream; btree_trace_reader
+ * reads them back, and btree_trace_apply does one to another tree (see
+ * trace_replay.cpp, which times a trace against different fanouts,
+ * search policies and allocators).
+ *
+ * A trace is a header ("BTRC", a version byte, and 'i' for integer keys
+ * or 's' for strings) followed by one record per operation: an op byte,
+ * the key, and for scans how many elems were read. Keys are written
+ * relative to the previous record's to keep traces small: integers as
+ * the zigzagged difference in a varint, strings as how much of the
+ * previous key they share followed by the rest. Random keys under a
+ * million come to about 4 bytes a record.
+ */
+
+#ifndef BTREE_TRACE_H
+#define BTREE_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "btree.h"
+
+enum class TraceOp : unsigned char { insert, find, scan, erase };
+
+template <typename T>
+struct btree_trace_record {
+    TraceOp op;
+    T key;
+    // how many elems from key onwards a scan read; 0 for anything else
+    std::size_t count;
+};
+
+// the bits of the format that don't depend on the key type
+class btree_trace_format {
+    public:
+        static constexpr char version = 1;
+
+        /**
+         * The key kind ('i' or 's') in the header of the trace in, leaving
+         * in where it was.
+         *
+         * @throws std::runtime_error if in doesn't start with a trace header
+         */
+        static char key_kind(std::istream& in) {
+            auto start = in.tellg();
+            char kind = readHeader_(in);
+            in.clear();
+            in.seekg(start);
+            return kind;
+        }
+
+    protected:
+        static const char* magic_() {
+            return "BTRC";
+        }
+
+        static void writeHeader_(std::ostream& out, char kind) {
+            out.write(magic_(), 4);
+            out.put(version);
+            out.put(kind);
+        }
+
+        static char readHeader_(std::istream& in) {
+            char header[6];
+            if (!in.read(header, sizeof(header)) || std::string(header, 4) != magic_()) {
+                throw std::runtime_error("btree trace: no trace header");
+            }
+            if (header[4] != version) {
+                throw std::runtime_error("btree trace: unknown version " + std::to_string(int(header[4])));
+            }
+            return header[5];
+        }
+
+        static void writeVarint_(std::ostream& out, std::uint64_t value) {
+            while (value >= 0x80) {
+                out.put(static_cast<char>((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            out.put(static_cast<char>(value));
+        }
+
+        static bool readVarint_(std::istream& in, std::uint64_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                int byte = in.get();
+                if (byte == std::char_traits<char>::eof()) {
+                    return false;
+                }
+                value |= std::uint64_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    return true;
+                }
+            }
+            throw std::runtime_error("btree trace: varint too long");
+        }
+};
+
+/**
+ * How keys of type T are written, relative to the last one. Integers and
+ * std::string are all there is so far.
+ */
+template <typename T, typename = void>
+class btree_trace_codec;
+
+template <typename T>
+class btree_trace_codec<T, std::enable_if_t<std::is_integral<T>::value>> : btree_trace_format {
+    public:
+        static constexpr char kind = 'i';
+
+        void write(std::ostream& out, const T& key) {
+            // differences wrap around, and zigzagging makes small negative ones small too
+            std::int64_t difference = static_cast<std::int64_t>(static_cast<std::uint64_t>(key) - previous);
+            writeVarint_(out, (static_cast<std::uint64_t>(difference) << 1) ^ static_cast<std::uint64_t>(difference >> 63));
+            previous = static_cast<std::uint64_t>(key);
+        }
+
+        bool read(std::istream& in, T& key) {
+            std::uint64_t zigzag;
+            if (!readVarint_(in, zigzag)) {
+                return false;
+            }
+            std::uint64_t difference = (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+            previous += difference;
+            key = static_cast<T>(previous);
+            return true;
+        }
+
+    private:
+        std::uint64_t previous = 0;
+};
+
+template <>
+class btree_trace_codec<std::string> : btree_trace_format {
+    public:
+        static constexpr char kind = 's';
+
+        void write(std::ostream& out, const std::string& key) {
+            std::size_t shared = 0;
+            while (shared < key.size() && shared < previous.size() && key[shared] == previous[shared]) {
+                ++shared;
+            }
+            writeVarint_(out, shared);
+            writeVarint_(out, key.size() - shared);
+            out.write(key.data() + shared, key.size() - shared);
+            previous = key;
+        }
+
+        bool read(std::istream& in, std::string& key) {
+            std::uint64_t shared, rest;
+            if (!readVarint_(in, shared) || !readVarint_(in, rest) || shared > previous.size()) {
+                return false;
+            }
+            previous.resize(shared + rest);
+            if (!in.read(&previous[shared], rest)) {
+                return false;
+            }
+            key = previous;
+            return true;
+        }
+
+    private:
+        std::string previous;
+};
+
+template <typename T>
+class btree_trace_writer : btree_trace_format {
+    public:
+        explicit btree_trace_writer(std::ostream& out_): out{out_} {
+            writeHeader_(out, btree_trace_codec<T>::kind);
+        }
+
+        void write(const btree_trace_record<T>& record) {
+            out.put(static_cast<char>(record.op));
+            codec.write(out, record.key);
+            if (record.op == TraceOp::scan) {
+                writeVarint_(out, record.count);
+            }
+            ++written;
+        }
+
+        std::size_t records() const {
+            return written;
+        }
+
+    private:
+        std::ostream& out;
+        btree_trace_codec<T> codec;
+        std::size_t written = 0;
+};
+
+template <typename T>
+class btree_trace_reader : btree_trace_format {
+    public:
+        /**
+         * @throws std::runtime_error if in isn't a trace of keys like T
+         */
+        explicit btree_trace_reader(std::istream& in_): in{in_} {
+            char kind = readHeader_(in);
+            if (kind != btree_trace_codec<T>::kind) {
+                throw std::runtime_error(std::string("btree trace: keys are of kind '") + kind + "', not '" +
+                                         btree_trace_codec<T>::kind + "'");
+            }
+        }
+
+        /**
+         * Reads the next record into record, returning false at the end of
+         * the trace.
+         *
+         * @throws std::runtime_error if the trace stops part way through a record
+         */
+        bool next(btree_trace_record<T>& record) {
+            int op = in.get();
+            if (op == std::char_traits<char>::eof()) {
+                return false;
+            }
+            if (op > static_cast<int>(TraceOp::erase)) {
+                throw std::runtime_error("btree trace: unknown op " + std::to_string(op));
+            }
+            record.op = static_cast<TraceOp>(op);
+            std::uint64_t count = 0;
+            if (!codec.read(in, record.key) || (record.op == TraceOp::scan && !readVarint_(in, count))) {
+                throw std::runtime_error("btree trace: truncated record");
+            }
+            record.count = static_cast<std::size_t>(count);
+            return true;
+        }
+
+    private:
+        std::istream& in;
+        btree_trace_codec<T> codec;
+};
+
+/**
+ * Does record's operation to tree, returning something that depends on
+ * the result so the caller can keep the optimiser from skipping it: for
+ * finds and erases whether key was there, for inserts whether it wasn't,
+ * and for scans how many elems were read.
+ */
+template <typename T, typename Alloc>
+std::size_t btree_trace_apply(btree<T, Alloc>& tree, const btree_trace_record<T>& record) {
+    switch (record.op) {
+        case TraceOp::insert:
+            return tree.insert(record.key).second;
+        case TraceOp::find:
+            return tree.find(record.key) != tree.end();
+        case TraceOp::scan: {
+            std::size_t read = 0;
+            for (auto it = tree.lower_bound(record.key); read < record.count && it != tree.end(); ++it) {
+                ++read;
+            }
+            return read;
+        }
+        case TraceOp::erase:
+            return tree.erase(record.key);
+    }
+    return 0;
+}
+
+/**
+ * Does what's asked of it to tree, and writes it to out as it goes. The
+ * trace starts with an insert of everything already in tree, a level at a
+ * time from the root down as operator<< prints them, so that replaying it
+ * into a tree of the same fanout starts from the same place. In order,
+ * they'd make a chain. A tree built only by inserts comes out node for
+ * node the same; one that's had elems erased from it comes out with the
+ * same elems, but maybe not in the same nodes.
+ */
+template <typename T, typename Alloc = std::allocator<T>>
+class btree_trace_recorder {
+    public:
+        using tree_type = btree<T, Alloc>;
+
+        btree_trace_recorder(tree_type& tree_, std::ostream& out): tree{tree_}, writer{out} {
+            tree.forEachBreadthFirst_([this](auto* node, auto i) {
+                writer.write(btree_trace_record<T>{TraceOp::insert, node->elems[i], 0});
+            });
+        }
+
+        std::pair<typename tree_type::iterator, bool> insert(const T& key) {
+            writer.write(btree_trace_record<T>{TraceOp::insert, key, 0});
+            return tree.insert(key);
+        }
+
+        typename tree_type::iterator find(const T& key) {
+            writer.write(btree_trace_record<T>{TraceOp::find, key, 0});
+            return tree.find(key);
+        }
+
+        // hands visit up to count elems from key onwards, returning how many there were
+        template <typename Visit>
+        std::size_t scan(const T& key, std::size_t count, Visit visit) {
+            writer.write(btree_trace_record<T>{TraceOp::scan, key, count});
+            std::size_t read = 0;
+            for (auto it = tree.lower_bound(key); read < count && it != tree.end(); ++it) {
+                visit(*it);
+                ++read;
+            }
+            return read;
+        }
+
+        typename tree_type::size_type erase(const T& key) {
+            writer.write(btree_trace_record<T>{TraceOp::erase, key, 0});
+            return tree.erase(key);
+        }
+
+        std::size_t records() const {
+            return writer.records();
+        }
+
+    private:
+        tree_type& tree;
+        btree_trace_writer<T> writer;
+};
+
+#endif
@@ -0,0 +1,395 @@
+/**
+ * Checking a btree against a container known to be right, e.g. a
+ * std::set the same elements went into, far faster than looking up every
+ * value either might hold:
+ *
+ *     auto result = btree_verify(tree, reference);
+ *     if (!result) std::cout << result.problem << "\n";
+ *
+ * The tree is walked in order alongside the reference (which has to be
+ * sorted and without duplicates: a std::set, or a sorted, uniqued
+ * vector), so every elem is compared once. On the way it checks what
+ * should always hold of the nodes:
+ *
+ * - elems are in order, and every elem under a child lies between the
+ *   elems either side of it
+ * - no node has more than maxNodeElems elems, and only the root is empty
+ * - a node has at most one more child than elems, and no null children
+ *   at the end
+ * - prefixes (see btree_key_traits.h) match their elems
+ * - with the hash index on, it finds each elem in the node it's in, and
+ *   holds nothing else
+ *
+ * The top of the tree is split into runs of whole subtrees and single
+ * elems, and the runs are checked on as many threads as asked for.
+ */
+
+#ifndef BTREE_VERIFY_H
+#define BTREE_VERIFY_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "btree.h"
+
+struct btree_verify_result {
+    bool ok = true;
+    // what was wrong, the first thing in order if there was more than one
+    std::string problem;
+    std::size_t elems = 0;
+    std::size_t nodes = 0;
+    // levels below the root of the deepest node
+    std::size_t max_depth = 0;
+
+    explicit operator bool() const {
+        return ok;
+    }
+};
+
+template <typename T, typename Alloc>
+class btree_verifier {
+    public:
+        using tree_type = btree<T, Alloc>;
+
+        /**
+         * Checks tree against reference on up to threads threads (0 for
+         * as many as the hardware has).
+         */
+        template <typename Reference>
+        static btree_verify_result verify(const tree_type& tree, const Reference& reference, unsigned threads) {
+            if (threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            btree_verifier verifier(tree);
+            if (!tree.head) {
+                btree_verify_result result;
+                if (!reference.empty()) {
+                    result.ok = false;
+                    result.problem = "the tree is empty but the reference isn't";
+                }
+                return result;
+            }
+
+            verifier.split_(threads * 8);
+            std::vector<btree_verify_result> results(verifier.runs.size());
+            std::atomic<std::size_t> next{0};
+            auto work = [&] {
+                for (std::size_t i = next++; i < verifier.runs.size(); i = next++) {
+                    results[i] = verifier.checkRun_(i, reference);
+                }
+            };
+            std::vector<std::thread> helpers;
+            for (unsigned t = 1; t < threads && t < verifier.runs.size(); ++t) {
+                helpers.emplace_back(work);
+            }
+            work();
+            for (auto& helper : helpers) {
+                helper.join();
+            }
+
+            btree_verify_result result = verifier.top;
+            for (const auto& run : results) {
+                result.elems += run.elems;
+                result.nodes += run.nodes;
+                result.max_depth = std::max(result.max_depth, run.max_depth);
+                if (result.ok && !run.ok) {
+                    result.ok = false;
+                    result.problem = run.problem;
+                }
+            }
+            if (result.ok && result.elems != static_cast<std::size_t>(reference.size())) {
+                result.ok = false;
+                result.problem = "the tree has " + std::to_string(result.elems) + " elems but the reference has " +
+                                 std::to_string(reference.size());
+            }
+            if (result.ok && tree.hashIndex && tree.hashIndex->size() != result.elems) {
+                result.ok = false;
+                result.problem = "the hash index holds " + std::to_string(tree.hashIndex->size()) + " elems but the tree has " +
+                                 std::to_string(result.elems);
+            }
+            return result;
+        }
+
+    private:
+        using Node = typename tree_type::Node;
+        using size_type = typename tree_type::size_type;
+
+        // a whole subtree, or (if node is null) just the one elem from a node split up above it
+        struct Run {
+            const Node* node;
+            const T* elem;
+            std::size_t depth;
+            // the nearest lone elems before and after, if there are any
+            const T* low;
+            const T* high;
+        };
+
+        explicit btree_verifier(const tree_type& tree_): tree{tree_} {}
+
+        /**
+         * Splits the top of the tree up until there are at least wanted
+         * runs, or nothing left to split. The nodes split up are checked
+         * here, since no run walks them.
+         */
+        void split_(std::size_t wanted) {
+            runs.push_back(Run{tree.head.get(), nullptr, 0, nullptr, nullptr});
+            bool split = true;
+            while (split && runs.size() < wanted) {
+                split = false;
+                std::vector<Run> finer;
+                for (const auto& run : runs) {
+                    if (run.node == nullptr || run.node->children.empty()) {
+                        finer.push_back(run);
+                        continue;
+                    }
+                    split = true;
+                    ++top.nodes;
+                    top.max_depth = std::max(top.max_depth, run.depth);
+                    if (top.ok) {
+                        std::string problem = checkNode_(run.node, run.depth == 0);
+                        if (!problem.empty()) {
+                            top.ok = false;
+                            top.problem = problem;
+                        }
+                    }
+                    const auto& elems = run.node->elems;
+                    const auto& children = run.node->children;
+                    for (size_type i = 0; i <= elems.size(); ++i) {
+                        if (i < children.size() && children[i]) {
+                            finer.push_back(Run{children[i].get(), nullptr, run.depth + 1, nullptr, nullptr});
+                        }
+                        if (i < elems.size()) {
+                            finer.push_back(Run{nullptr, &elems[i], run.depth, nullptr, nullptr});
+                        }
+                    }
+                }
+                runs = std::move(finer);
+            }
+
+            const T* low = nullptr;
+            for (auto& run : runs) {
+                run.low = low;
+                if (run.node == nullptr) {
+                    low = run.elem;
+                }
+            }
+            const T* high = nullptr;
+            for (auto run = runs.rbegin(); run != runs.rend(); ++run) {
+                run->high = high;
+                if (run->node == nullptr) {
+                    high = run->elem;
+                }
+            }
+        }
+
+        /**
+         * Walks runs[i] in order alongside the reference's elems between
+         * the lone elems either side of it.
+         */
+        template <typename Reference>
+        btree_verify_result checkRun_(std::size_t i, const Reference& reference) const {
+            btree_verify_result result;
+            const T* low = runs[i].low;
+            const T* high = runs[i].high;
+
+            if (runs[i].node == nullptr) {
+                // a lone elem answers for the reference's elems from the
+                // last one accounted for up to itself, and if it's last, for the rest
+                const T& elem = *runs[i].elem;
+                result.elems = 1;
+                auto expected = i > 0 && runs[i - 1].node != nullptr ? lowerBound_(reference, elem)
+                                : low ? upperBound_(reference, *low) : reference.begin();
+                if (low != nullptr && !(*low < elem)) {
+                    fail_(result, describe_(elem) + " comes after " + describe_(*low) + " but isn't bigger");
+                } else if (expected != reference.end() && *expected < elem) {
+                    fail_(result, "the reference has " + describe_(*expected) + " but the tree doesn't");
+                } else if (expected == reference.end() || !(*expected == elem)) {
+                    fail_(result, "the tree has " + describe_(elem) + " but the reference doesn't");
+                } else if (i + 1 == runs.size() && ++expected != reference.end()) {
+                    fail_(result, "the reference has " + describe_(*expected) + " but the tree doesn't");
+                }
+                return result;
+            }
+
+            auto expected = low ? upperBound_(reference, *low) : reference.begin();
+            auto expectedEnd = high ? lowerBound_(reference, *high) : reference.end();
+            const T* previous = low;
+            auto visit = [&](const T& elem) {
+                ++result.elems;
+                if (!result.ok) {
+                    return;
+                }
+                if ((previous && !(*previous < elem)) || (high && !(elem < *high))) {
+                    fail_(result, describe_(elem) + " is out of order");
+                } else if (expected == expectedEnd || !(*expected == elem)) {
+                    fail_(result, expected == expectedEnd || elem < *expected
+                        ? "the tree has " + describe_(elem) + " but the reference doesn't"
+                        : "the reference has " + describe_(*expected) + " but the tree doesn't");
+                } else {
+                    ++expected;
+                }
+                previous = &elem;
+            };
+
+            // each frame's step goes child 0, elem 0, child 1, elem 1, ... child n
+            struct Frame {
+                const Node* node;
+                size_type step;
+                std::size_t depth;
+            };
+            std::vector<Frame> stack;
+            auto enter = [&](const Node* node, std::size_t depth) {
+                ++result.nodes;
+                result.max_depth = std::max(result.max_depth, depth);
+                if (result.ok) {
+                    std::string problem = checkNode_(node, depth == 0);
+                    if (!problem.empty()) {
+                        fail_(result, problem);
+                    }
+                }
+                stack.push_back(Frame{node, 0, depth});
+            };
+            enter(runs[i].node, runs[i].depth);
+            while (!stack.empty()) {
+                Frame& frame = stack.back();
+                const Node* node = frame.node;
+                size_type step = frame.step++;
+                if (step == 2 * node->elems.size() + 1) {
+                    stack.pop_back();
+                } else if (step % 2 == 1) {
+                    visit(node->elems[step / 2]);
+                } else if (step / 2 < node->children.size() && node->children[step / 2]) {
+                    enter(node->children[step / 2].get(), frame.depth + 1);
+                }
+            }
+            if (result.ok && expected != expectedEnd) {
+                fail_(result, "the reference has " + describe_(*expected) + " but the tree doesn't");
+            }
+            return result;
+        }
+
+        // what's wrong with node on its own, if anything
+        std::string checkNode_(const Node* node, bool root) const {
+            const auto& elems = node->elems;
+            const auto& children = node->children;
+            if (elems.size() > tree.maxNodeElems) {
+                return "a node has " + std::to_string(elems.size()) + " elems, more than maxNodeElems";
+            }
+            if (elems.empty() && !root) {
+                return "a node other than the root is empty";
+            }
+            if (children.size() > elems.size() + 1) {
+                return "a node has " + std::to_string(children.size()) + " children for " +
+                       std::to_string(elems.size()) + " elems";
+            }
+            if (!children.empty() && !children.back()) {
+                return "a node's last child is null";
+            }
+            for (size_type i = 1; i < elems.size(); ++i) {
+                if (!(elems[i - 1] < elems[i])) {
+                    return "a node's elems are out of order at " + describe_(elems[i]);
+                }
+            }
+            std::string problem = checkPrefixes_(node, typename tree_type::Normalized());
+            if (!problem.empty()) {
+                return problem;
+            }
+            if (tree.hashIndex) {
+                for (const auto& elem : elems) {
+                    Node* indexed = tree.hashIndex->find(tree_type::hashOf_(elem), [&](Node* candidate) {
+                        return candidate == node;
+                    });
+                    if (indexed != node) {
+                        return "the hash index doesn't have " + describe_(elem) + " where it is";
+                    }
+                }
+            }
+            return "";
+        }
+
+        std::string checkPrefixes_(const Node* node, std::true_type) const {
+            if (node->prefixes.size() != node->elems.size()) {
+                return "a node has " + std::to_string(node->prefixes.size()) + " prefixes for " +
+                       std::to_string(node->elems.size()) + " elems";
+            }
+            for (size_type i = 0; i < node->elems.size(); ++i) {
+                if (!(node->prefixes[i] == tree_type::keyTraits::prefix(node->elems[i]))) {
+                    return "the prefix of " + describe_(node->elems[i]) + " is wrong";
+                }
+            }
+            return "";
+        }
+
+        std::string checkPrefixes_(const Node*, std::false_type) const {
+            return "";
+        }
+
+        static void fail_(btree_verify_result& result, std::string problem) {
+            result.ok = false;
+            result.problem = std::move(problem);
+        }
+
+        // elem as it prints, if it can be printed
+        template <typename U>
+        static std::string describe_(const U& elem) {
+            return describeAs_(elem, 0);
+        }
+
+        template <typename U>
+        static auto describeAs_(const U& elem, int) -> decltype(std::declval<std::ostream&>() << elem, std::string()) {
+            std::ostringstream out;
+            out << elem;
+            return out.str();
+        }
+
+        template <typename U>
+        static std::string describeAs_(const U&, long) {
+            return "an elem";
+        }
+
+        // the reference's own lower_bound and upper_bound where it has them (std::set), or std's
+        template <typename Reference>
+        static auto lowerBound_(const Reference& reference, const T& elem) -> decltype(reference.lower_bound(elem)) {
+            return reference.lower_bound(elem);
+        }
+
+        template <typename Reference, typename... Ignored>
+        static auto lowerBound_(const Reference& reference, const T& elem, Ignored...) {
+            return std::lower_bound(reference.begin(), reference.end(), elem);
+        }
+
+        template <typename Reference>
+        static auto upperBound_(const Reference& reference, const T& elem) -> decltype(reference.upper_bound(elem)) {
+            return reference.upper_bound(elem);
+        }
+
+        template <typename Reference, typename... Ignored>
+        static auto upperBound_(const Reference& reference, const T& elem, Ignored...) {
+            return std::upper_bound(reference.begin(), reference.end(), elem);
+        }
+
+        const tree_type& tree;
+        // the tree's top, split up
+        std::vector<Run> runs;
+        // what was found checking the nodes split up
+        btree_verify_result top;
+};
+
+/**
+ * Checks that tree holds exactly what reference does, and that its nodes
+ * are as they should be, on up to threads threads (0 for as many as the
+ * hardware has). See btree_verifier above.
+ */
+template <typename T, typename Alloc, typename Reference>
+btree_verify_result btree_verify(const btree<T, Alloc>& tree, const Reference& reference, unsigned threads = 0) {
+    return btree_verifier<T, Alloc>::verify(tree, reference, threads);
+}
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * A persistent btree: every change makes a new version, and recent
+ * versions stay readable "as of" when they were made.
+ *
+ * Versions are ordinary btrees sharing nodes copy-on-write, so a change
+ * copies only the path it touches (path copying) and every other node is
+ * shared with the version before. Only the last maxVersions versions are
+ * kept. A node is freed once no kept version (or outstanding handle)
+ * reaches it any more.
+ */
+
+#ifndef BTREE_VERSIONS_H
+#define BTREE_VERSIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "btree.h"
+
+template <typename T>
+class btree_versions {
+    public:
+        using version_id = std::uint64_t;
+        using size_type = typename btree<T>::size_type;
+        using const_iterator = typename btree<T>::const_iterator;
+
+        /**
+         * A handle on one version. Handles are cheap to copy, and the
+         * version stays readable for as long as a handle to it exists,
+         * even after btree_versions itself has stopped keeping it.
+         */
+        class version {
+            public:
+                version_id id() const {
+                    return id_;
+                }
+
+                const btree<T>& tree() const {
+                    return *tree_;
+                }
+
+                const_iterator find(const T& elem) const {
+                    return tree_->find(elem);
+                }
+
+                const_iterator begin() const {
+                    return tree_->begin();
+                }
+
+                const_iterator end() const {
+                    return tree_->end();
+                }
+
+            private:
+                friend class btree_versions;
+
+                version(version_id id, std::shared_ptr<const btree<T>> tree): id_{id}, tree_{std::move(tree)} {}
+
+                version_id id_;
+                std::shared_ptr<const btree<T>> tree_;
+        };
+
+        /**
+         * Starts with an empty version 0.
+         *
+         * @param maxNodeElems the maximum number of elements
+         *        that can be stored in each B-Tree node
+         * @param maxVersions how many of the latest versions to keep
+         */
+        btree_versions(size_type maxNodeElems = 40, std::size_t maxVersions_ = 16): maxVersions{maxVersions_ ? maxVersions_ : 1} {
+            versions.push_back(version(0, std::make_shared<const btree<T>>(maxNodeElems)));
+        }
+
+        /**
+         * Inserts elem into a new version based on the latest one.
+         *
+         * @return the new version, and true; or if elem was already there,
+         *         the latest version (unchanged) and false
+         */
+        std::pair<version, bool> insert(const T& elem) {
+            auto next = std::make_shared<btree<T>>(latest().tree());
+            if (!next->insert(elem).second) {
+                return std::make_pair(latest(), false);
+            }
+            return std::make_pair(push_(std::move(next)), true);
+        }
+
+        /**
+         * Erases elem in a new version based on the latest one.
+         *
+         * @return the new version, and true; or if elem wasn't there,
+         *         the latest version (unchanged) and false
+         */
+        std::pair<version, bool> erase(const T& elem) {
+            auto next = std::make_shared<btree<T>>(latest().tree());
+            if (next->erase(elem) == 0) {
+                return std::make_pair(latest(), false);
+            }
+            return std::make_pair(push_(std::move(next)), true);
+        }
+
+        // the newest version
+        const version& latest() const {
+            return versions.back();
+        }
+
+        // the oldest version still kept
+        const version& oldest() const {
+            return versions.front();
+        }
+
+        bool contains(version_id id) const {
+            return oldest().id() <= id && id <= latest().id();
+        }
+
+        /**
+         * Returns the version with the given id.
+         *
+         * @throws std::out_of_range if that version is no longer (or not
+         *         yet) kept
+         */
+        const version& at(version_id id) const {
+            if (!contains(id)) {
+                throw std::out_of_range("btree_versions::at: version " + std::to_string(id) + " isn't kept");
+            }
+            return versions[id - oldest().id()];
+        }
+
+        std::size_t max_versions() const {
+            return maxVersions;
+        }
+
+        /**
+         * Changes how many versions are kept, dropping the oldest ones
+         * straight away if there are now too many.
+         */
+        void max_versions(std::size_t maxVersions_) {
+            maxVersions = maxVersions_ ? maxVersions_ : 1;
+            trim_();
+        }
+
+    private:
+        const version& push_(std::shared_ptr<const btree<T>> tree) {
+            versions.push_back(version(latest().id() + 1, std::move(tree)));
+            trim_();
+            return versions.back();
+        }
+
+        // dropping a version frees whichever of its nodes nothing else shares
+        void trim_() {
+            while (versions.size() > maxVersions) {
+                versions.pop_front();
+            }
+        }
+
+        // consecutive ids, oldest first
+        std::deque<version> versions;
+        std::size_t maxVersions;
+};
+
+#endif
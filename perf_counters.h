@@ -0,0 +1,205 @@
+/**
+ * Hardware event counts for the benchmarks, through Linux's
+ * perf_event_open. Counting needs a kernel that allows it (see
+ * /proc/sys/kernel/perf_event_paranoid), and doesn't work in many VMs and
+ * containers; elsewhere the counters just say they aren't available.
+ *
+ * When there are more events than hardware counters the kernel takes
+ * turns with them, and each count is scaled up by how long its event
+ * wasn't being counted for, so counts can be estimates.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+/**
+ * Counts one event for this thread, in user space only, between start()
+ * and stop().
+ */
+class PerfCounter {
+    public:
+#ifdef __linux__
+        PerfCounter(std::uint32_t type, std::uint64_t config) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+
+        static PerfCounter cycles() {
+            return PerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        }
+
+        static PerfCounter instructions() {
+            return PerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        }
+
+        static PerfCounter branchMisses() {
+            return PerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        }
+
+        // level 1 data cache misses on loads
+        static PerfCounter l1dLoadMisses() {
+            return loadMisses_(PERF_COUNT_HW_CACHE_L1D);
+        }
+
+        // last level cache misses on loads
+        static PerfCounter llcLoadMisses() {
+            return loadMisses_(PERF_COUNT_HW_CACHE_LL);
+        }
+
+        // data TLB misses on loads
+        static PerfCounter dtlbLoadMisses() {
+            return loadMisses_(PERF_COUNT_HW_CACHE_DTLB);
+        }
+#else
+        static PerfCounter cycles() { return PerfCounter(); }
+        static PerfCounter instructions() { return PerfCounter(); }
+        static PerfCounter branchMisses() { return PerfCounter(); }
+        static PerfCounter l1dLoadMisses() { return PerfCounter(); }
+        static PerfCounter llcLoadMisses() { return PerfCounter(); }
+        static PerfCounter dtlbLoadMisses() { return PerfCounter(); }
+#endif
+
+        PerfCounter(const PerfCounter&) = delete;
+        PerfCounter& operator=(const PerfCounter&) = delete;
+
+        PerfCounter(PerfCounter&& other) noexcept: fd{other.fd} {
+            other.fd = -1;
+        }
+
+        ~PerfCounter() {
+#ifdef __linux__
+            if (fd >= 0) {
+                close(fd);
+            }
+#endif
+        }
+
+        bool available() const {
+            return fd >= 0;
+        }
+
+        void start() {
+#ifdef __linux__
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        // how many events there were since start(), or 0 if counting isn't available
+        std::uint64_t stop() {
+            std::uint64_t count = 0;
+#ifdef __linux__
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                // the count, how long the event was enabled, and how long it was actually counted
+                std::uint64_t values[3];
+                if (read(fd, values, sizeof(values)) == sizeof(values) && values[2] > 0) {
+                    count = values[2] < values[1]
+                        ? static_cast<std::uint64_t>(double(values[0]) * values[1] / values[2])
+                        : values[0];
+                }
+            }
+#endif
+            return count;
+        }
+
+    private:
+        PerfCounter() = default;
+
+#ifdef __linux__
+        static PerfCounter loadMisses_(std::uint64_t cache) {
+            return PerfCounter(PERF_TYPE_HW_CACHE,
+                               cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        }
+#endif
+
+        int fd = -1;
+};
+
+// one event's count over a region, if it could be counted
+struct PerfCount {
+    const char* name;
+    bool available;
+    double count;
+};
+
+/**
+ * The events the benchmarks count, all at once: cycles, instructions,
+ * L1d and LLC load misses, branch misses and dTLB load misses. Opening
+ * them costs a few system calls, so each thread opens its own set once.
+ */
+class PerfCounters {
+    public:
+        static PerfCounters& forThisThread() {
+            static thread_local PerfCounters counters;
+            return counters;
+        }
+
+        bool anyAvailable() const {
+            for (const auto& event : events) {
+                if (event.counter.available()) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void start() {
+            for (auto& event : events) {
+                event.counter.start();
+            }
+        }
+
+        // every event, in the same order each time, whether or not it could be counted
+        std::vector<PerfCount> stop() {
+            std::vector<PerfCount> counts;
+            for (auto& event : events) {
+                std::uint64_t count = event.counter.stop();
+                counts.push_back(PerfCount{event.name, event.counter.available(), static_cast<double>(count)});
+            }
+            return counts;
+        }
+
+    private:
+        struct Event {
+            const char* name;
+            PerfCounter counter;
+        };
+
+        PerfCounters() {
+            events.push_back(Event{"cycles", PerfCounter::cycles()});
+            events.push_back(Event{"instructions", PerfCounter::instructions()});
+            events.push_back(Event{"l1d_misses", PerfCounter::l1dLoadMisses()});
+            events.push_back(Event{"llc_misses", PerfCounter::llcLoadMisses()});
+            events.push_back(Event{"branch_misses", PerfCounter::branchMisses()});
+            events.push_back(Event{"dtlb_misses", PerfCounter::dtlbLoadMisses()});
+        }
+
+        std::vector<Event> events;
+};
+
+}  // namespace bench
+
+#endif
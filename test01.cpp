@@ -11,7 +11,6 @@
 
 #include <algorithm>
 #include <cstddef>
-#include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <iostream>
@@ -20,12 +19,15 @@
 #include <utility>
 
 #include "btree.h"
+#include "btree_verify.h"
+#include "workload.h"
 
 using std::copy;
 using std::cout;
 using std::endl;
 using std::ifstream;
 using std::ofstream;
+using std::pair;
 using std::set;
 using std::string;
 
@@ -34,6 +36,8 @@ namespace {
 const long kMinInteger = 1000000;
 const long kMaxInteger = 100000000;
 
+workload::Xoshiro256 rng(0);
+
 void initRandom(unsigned long);
 long getRandom(long low, long high);
 void insertRandomNumbers(btree<long>&, set<long>&, size_t);
@@ -46,19 +50,18 @@ bool confirmEverythingMatches(const btree<long>&, const set<long>&);
  **/
 void initRandom(unsigned long seed = 0) {
   if (seed == 0) {
-    srandom(time(NULL));
+    rng = workload::Xoshiro256(time(NULL));
   } else {
-    srandom(seed);
+    rng = workload::Xoshiro256(seed);
   }
 }
 
 /**
- * Produces a random number in the given range.
- * The random() function provides better quality random numbers
- * than the older rand() function.
+ * Produces a random number in the given range, every number in it
+ * equally likely (which random() % range isn't quite).
  **/
 long getRandom(long low, long high) {
-  return (low + (random() % ((high - low) + 1)));
+  return rng.between(low, high);
 }
 
 /**
@@ -81,25 +84,21 @@ void insertRandomNumbers(btree<long>& testContainer, set<long>& stableContainer,
 
 /**
  * Confirms that the specified btree and the specified 
- * set contain exactly the same numbers.  This does so by 
- * considering all numbers that could have been added, and 
- * asserting that each of those numbers is either present 
- * in or absent from both containers.  If all checks out, 
- * we return 0 to signal success; if along the way we see 
- * an integer in one container and not the other, then 
- * we bail immediately and return one to express failure.
+ * set contain exactly the same numbers.  This walks both 
+ * in order side by side (see btree_verify.h), checking the 
+ * btree's nodes are in good shape as it goes, rather than 
+ * looking up every number that could have been added.  If 
+ * all checks out, we return true; otherwise we say what 
+ * the first difference was and return false.
  **/
 bool confirmEverythingMatches(const btree<long>& testContainer, const set<long>& stableContainer) {
   cout << "Confirms the btree and the set " 
           "contain exactly the same values..." << endl;
-  for (long i = kMinInteger; i <= kMaxInteger; i++) {
-    bool foundInTree = (testContainer.find(i) != testContainer.end());
-    bool foundInSet = (stableContainer.find(i) != stableContainer.end());
-    if (foundInTree != foundInSet) {
-      cout << "- btree and set don't contain the same data!" << endl; 
-      cout << "Mismatch at element: " << i << endl;
-      return false;
-    }
+  btree_verify_result result = btree_verify(testContainer, stableContainer);
+  if (!result) {
+    cout << "- btree and set don't contain the same data!" << endl; 
+    cout << result.problem << endl;
+    return false;
   }
   cout << "- btree checks out just fine." << endl;
 
@@ -0,0 +1,84 @@
+#include <initializer_list>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "btree.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+// every search policy should find exactly what std::set finds
+template <typename T, typename F>
+bool checkPolicies(F makeElem, typename btree<T>::size_type maxNodeElems) {
+    btree<T> tree(maxNodeElems);
+    std::set<T> set;
+    fillBoth(tree, set, 5000, makeElem);
+    for (auto policy : {SearchPolicy::linear, SearchPolicy::binary, SearchPolicy::interpolation}) {
+        tree.search_policy(policy);
+        if (!findsLikeSet(tree, set, 5000, makeElem)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// finds through the hash index should agree with std::set whether the index
+// was on from the start, turned on later, or copied along with the tree
+bool checkHashIndex(btree<unsigned int>::size_type maxNodeElems) {
+    btree<long> indexedFromStart(maxNodeElems);
+    indexedFromStart.hash_index(true);
+    btree<long> indexedLater(maxNodeElems);
+    std::set<long> set;
+    for (int i = 0; i < 5000; ++i) {
+        long elem = rng.below(20000);
+        if (indexedFromStart.insert(elem).second != set.insert(elem).second) {
+            return false;
+        }
+        indexedLater.insert(elem);
+    }
+    indexedLater.hash_index(true);
+    const btree<long> copy = indexedFromStart;
+
+    for (const btree<long>* tree : std::initializer_list<const btree<long>*>{&indexedFromStart, &indexedLater, &copy}) {
+        // everything from -1 to 20000
+        long probe = -1;
+        if (!tree->hash_index() || !findsLikeSet(*tree, set, 20002, [&probe] { return probe++; })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// no std::hash for this, so its trees can't turn the hash index on, only off
+struct Unhashable {
+    int value;
+};
+
+bool operator<(const Unhashable& a, const Unhashable& b) { return a.value < b.value; }
+bool operator==(const Unhashable& a, const Unhashable& b) { return a.value == b.value; }
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    bool ok = true;
+    ok &= check(checkPolicies<long>([] { return rng.below(20000); }, 4));
+    ok &= check(checkPolicies<long>([] { return rng.below(20000); }, 40));
+    // skewed: mostly small numbers with a few huge ones
+    ok &= check(checkPolicies<long>([] { return rng.below(100) == 0 ? rng.below(1L << 31) : rng.below(1000); }, 40));
+    // keys near 2^62 too close together for doubles to tell apart, with plenty of repeats
+    ok &= check(checkPolicies<long>([] { return (1L << 62) + 2 * rng.between(0, 399); }, 64));
+    ok &= check(checkPolicies<double>([] { return rng.below(10000) / 7.0; }, 16));
+    ok &= check(checkPolicies<std::string>([] { return std::to_string(rng.below(10000)); }, 8));
+    ok &= check(checkHashIndex(3));
+    ok &= check(checkHashIndex(40));
+
+    btree<Unhashable> unhashable(4);
+    unhashable.hash_index(false);
+    unhashable.insert(Unhashable{1});
+    bool found = unhashable.find(Unhashable{1}) != unhashable.end();
+    std::cout << found << " " << unhashable.hash_index() << "\n";
+    ok &= found && !unhashable.hash_index();
+    return ok ? 0 : 1;
+}
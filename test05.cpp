@@ -0,0 +1,54 @@
+#include <iostream>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "btree.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+// opt in to normalized keys for the types below
+template <> struct btree_key_traits<std::string> : btree_string_prefix {};
+template <> struct btree_key_traits<std::pair<int, int>> : btree_tuple_prefix<std::pair<int, int>> {};
+template <> struct btree_key_traits<std::tuple<short, long, int>> : btree_tuple_prefix<std::tuple<short, long, int>> {};
+
+// a normalized tree should find exactly what std::set finds, whatever the search policy
+template <typename T, typename F>
+bool checkNormalized(F makeElem) {
+    btree<T> tree(8);
+    std::set<T> set;
+    if (!fillBoth(tree, set, 5000, makeElem)) {
+        return false;
+    }
+    for (auto policy : {SearchPolicy::linear, SearchPolicy::binary, SearchPolicy::interpolation}) {
+        tree.search_policy(policy);
+        if (!findsLikeSet(tree, set, 5000, makeElem)) {
+            return false;
+        }
+    }
+    // and iterate in the same order
+    return matches(tree, set);
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    // strings that share long prefixes, differ only past the eighth byte, or contain nulls and high bytes
+    std::cout << checkNormalized<std::string>([] {
+        std::string elem = "comp" + std::to_string(rng.below(100));
+        elem += std::string(rng.below(3), '\0');
+        elem += static_cast<char>(rng.below(256));
+        elem += std::to_string(rng.below(10));
+        return elem;
+    }) << "\n";
+    std::cout << checkNormalized<std::pair<int, int>>([] {
+        return std::make_pair(static_cast<int>(rng.between(-100, 99)), static_cast<int>(rng.between(-100, 99)));
+    }) << "\n";
+    // the long gets cut off, so some ties need the tuple compared
+    std::cout << checkNormalized<std::tuple<short, long, int>>([] {
+        return std::make_tuple(static_cast<short>(rng.between(-2, 2)), rng.between(-3, 3), static_cast<int>(rng.below(50)));
+    }) << "\n";
+}
@@ -0,0 +1,35 @@
+#include <cstddef>
+#include <iostream>
+#include <set>
+
+#include "btree.h"
+#include "btree_learned.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+// the learned index should find exactly what std::set finds
+bool checkLearned(btree<long>::size_type maxNodeElems, std::size_t maxError) {
+    btree<long> tree(maxNodeElems);
+    std::set<long> set;
+    // mostly dense keys with some spread out ones to make several segments
+    int made = 0;
+    fillBoth(tree, set, 20000, [&made] { return rng.between(0, 99999) * (made++ % 3 ? 1 : 17); });
+
+    btree_learned_index<long> index(tree, maxError);
+    // the index has its own copy
+    tree.insert(-1);
+
+    // everything from -5 to 199999
+    long probe = -5;
+    return findsLikeSet(index, set, 200005, [&probe] { return probe++; });
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    std::cout << checkLearned(2, 1) << "\n";
+    std::cout << checkLearned(5, 4) << "\n";
+    std::cout << checkLearned(40, 64) << "\n";
+}
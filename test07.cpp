@@ -0,0 +1,81 @@
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "btree_radix.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+// the radix index should find exactly what std::set finds
+template <typename F>
+bool checkRadix(btree<std::string>& tree, const std::set<std::string>& set, std::size_t maxGroupSize, F makeProbe) {
+    btree_radix_index index(tree, maxGroupSize);
+    return findsLikeSet(index, set, 20000, makeProbe);
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    // words, and every prefix of them, so that plenty of keys end where others carry on
+    btree<std::string> words(4);
+    std::set<std::string> wordSet;
+    std::ifstream wordFile("twl.txt");
+    if (!wordFile) {
+        std::cerr << "can't open twl.txt; run this from the directory it's in\n";
+        return 1;
+    }
+    std::string word;
+    while (std::getline(wordFile, word)) {
+        for (std::size_t length = 0; length <= word.size(); ++length) {
+            words.insert(word.substr(0, length));
+            wordSet.insert(word.substr(0, length));
+        }
+    }
+    if (wordSet.empty()) {
+        std::cerr << "twl.txt has no words in it\n";
+        return 1;
+    }
+    std::vector<std::string> wordList(wordSet.begin(), wordSet.end());
+    auto wordProbe = [&] {
+        std::string probe = wordList[rng.below(wordList.size())];
+        if (rng.below(2)) {
+            probe += static_cast<char>('A' + rng.below(26));
+        }
+        return probe;
+    };
+    bool ok = true;
+    ok &= check(checkRadix(words, wordSet, 1, wordProbe));
+    ok &= check(checkRadix(words, wordSet, 4, wordProbe));
+
+    // long shared prefixes and bytes of every value
+    btree<std::string> urls(40);
+    std::set<std::string> urlSet;
+    auto makeUrl = [] {
+        std::string url = "https://example.com/users/" + std::to_string(rng.below(5000));
+        url += static_cast<char>(rng.below(256));
+        return url;
+    };
+    fillBoth(urls, urlSet, 20000, makeUrl);
+    ok &= check(checkRadix(urls, urlSet, 0, makeUrl));
+    ok &= check(checkRadix(urls, urlSet, 2, makeUrl));
+
+    // a tree with no room in its nodes still gets groups of one key, and
+    // keys that end where others carry on don't send the build round in circles
+    btree<std::string> unsized(0);
+    std::set<std::string> unsizedSet;
+    for (const auto& elem : {"a", "ab", "abc", "b"}) {
+        unsized.insert(elem);
+        unsizedSet.insert(elem);
+    }
+    std::vector<std::string> unsizedList(unsizedSet.begin(), unsizedSet.end());
+    unsizedList.push_back("abcd");
+    unsizedList.push_back("");
+    ok &= check(checkRadix(unsized, unsizedSet, 0, [&] { return unsizedList[rng.below(unsizedList.size())]; }));
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#include <cstddef>
+#include <iostream>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+#include "btree.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+// copies share nodes, so writing to one mustn't show up in any other
+bool checkCopiesAreIndependent(btree<long>::size_type maxNodeElems, bool hashIndex) {
+    btree<long> original(maxNodeElems);
+    if (hashIndex) {
+        original.hash_index(true);
+    }
+    std::set<long> originalSet;
+    for (int i = 0; i < 2000; ++i) {
+        long elem = rng.below(10000);
+        original.insert(elem);
+        originalSet.insert(elem);
+    }
+
+    // a copy of a copy, and copies taken part way through writing
+    std::vector<btree<long>> copies;
+    std::vector<std::set<long>> copySets;
+    for (int generation = 0; generation < 5; ++generation) {
+        copies.push_back(generation == 0 ? original : copies.back());
+        copySets.push_back(generation == 0 ? originalSet : copySets.back());
+        for (int i = 0; i < 500; ++i) {
+            long elem = rng.below(20000);
+            copies.back().insert(elem);
+            copySets.back().insert(elem);
+        }
+    }
+    for (int i = 0; i < 500; ++i) {
+        long elem = rng.below(20000);
+        original.insert(elem);
+        originalSet.insert(elem);
+    }
+
+    if (!matches(original, originalSet)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < copies.size(); ++i) {
+        if (!matches(copies[i], copySets[i])) {
+            return false;
+        }
+        for (long elem = 0; elem < 20000; ++elem) {
+            if ((copies[i].find(elem) != copies[i].end()) != (copySets[i].count(elem) == 1)) {
+                return false;
+            }
+        }
+    }
+
+    // assigning over a copy drops what it had and shares the other's nodes instead
+    copies.front() = copies.back();
+    copies.back().insert(-1);
+    return matches(copies.front(), copySets.back()) && copies.front().find(-1) == copies.front().end();
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    bool ok = true;
+    ok &= check(checkCopiesAreIndependent(1, false));
+    ok &= check(checkCopiesAreIndependent(4, false));
+    ok &= check(checkCopiesAreIndependent(40, false));
+    ok &= check(checkCopiesAreIndependent(4, true));
+
+    // copying an empty tree is fine too
+    btree<long> empty;
+    btree<long> emptyCopy = empty;
+    emptyCopy.insert(1);
+    bool emptyStill = empty.begin() == empty.end();
+    bool copyGrew = matches(emptyCopy, std::set<long>{1});
+    std::cout << emptyStill << " " << copyGrew << "\n";
+    ok &= emptyStill && copyGrew;
+
+    // elements might be shared with a copy, so iterators can't write to them
+    bool constReference = std::is_const<std::remove_reference_t<btree<long>::iterator::reference>>::value;
+    bool constPointer = std::is_const<std::remove_pointer_t<btree<long>::iterator::pointer>>::value;
+    std::cout << constReference << " " << constPointer << "\n";
+    ok &= constReference && constPointer;
+    return ok ? 0 : 1;
+}
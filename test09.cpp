@@ -0,0 +1,77 @@
+#include <cstddef>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "btree.h"
+#include "btree_versions.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+// every kept version should still hold exactly what it held when it was made
+bool checkVersions(btree<long>::size_type maxNodeElems, std::size_t maxVersions) {
+    btree_versions<long> versions(maxNodeElems, maxVersions);
+    std::vector<std::set<long>> history{std::set<long>()};
+    std::vector<btree_versions<long>::version> handles{versions.latest()};
+
+    for (int i = 0; i < 3000; ++i) {
+        // mostly inserts, with the odd erase
+        long elem = rng.below(5000);
+        bool erasing = rng.below(4) == 0;
+        auto result = erasing ? versions.erase(elem) : versions.insert(elem);
+        std::set<long> next = history.back();
+        if (result.second != (erasing ? next.erase(elem) == 1 : next.insert(elem).second)) {
+            return false;
+        }
+        if (result.second) {
+            history.push_back(next);
+            handles.push_back(result.first);
+        }
+        if (result.first.id() != history.size() - 1) {
+            return false;
+        }
+    }
+
+    for (btree_versions<long>::version_id id = 0; id < history.size(); ++id) {
+        // the last maxVersions are kept; anything older is only readable through its handle
+        bool kept = id + maxVersions >= history.size();
+        if (versions.contains(id) != kept) {
+            return false;
+        }
+        const auto& version = kept ? versions.at(id) : handles[id];
+        auto setIt = history[id].begin();
+        for (auto elem : version) {
+            if (setIt == history[id].end() || elem != *setIt++) {
+                return false;
+            }
+        }
+        if (setIt != history[id].end()) {
+            return false;
+        }
+        for (long elem = 0; elem < 5000; elem += 7) {
+            if ((version.find(elem) != version.end()) != (history[id].count(elem) == 1)) {
+                return false;
+            }
+        }
+    }
+
+    try {
+        versions.at(0);
+        return maxVersions >= history.size();
+    } catch (const std::out_of_range&) {
+        return maxVersions < history.size();
+    }
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    bool ok = true;
+    ok &= check(checkVersions(3, 1));
+    ok &= check(checkVersions(3, 100));
+    ok &= check(checkVersions(40, 10000));
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "btree.h"
+#include "btree_verify.h"
+#include "test_util.h"
+
+// counts how it gets made so we can see what insert copies
+struct Counted {
+    static int constructs;
+    static int copies;
+    static int moves;
+
+    Counted(): value{0} {}
+    Counted(int value_): value{value_} { ++constructs; }
+    Counted(const Counted& other): value{other.value} { ++copies; }
+    Counted(Counted&& other) noexcept: value{other.value} { ++moves; }
+    Counted& operator=(const Counted& other) { value = other.value; ++copies; return *this; }
+    Counted& operator=(Counted&& other) noexcept { value = other.value; ++moves; return *this; }
+
+    static void reset() {
+        constructs = copies = moves = 0;
+    }
+
+    int value;
+};
+
+int Counted::constructs = 0;
+int Counted::copies = 0;
+int Counted::moves = 0;
+
+bool operator<(const Counted& a, const Counted& b) { return a.value < b.value; }
+bool operator==(const Counted& a, const Counted& b) { return a.value == b.value; }
+bool operator<(const Counted& a, int b) { return a.value < b; }
+bool operator==(const Counted& a, int b) { return a.value == b; }
+
+// can't be made from a negative number
+struct Picky {
+    Picky(int value_): value{value_} {
+        if (value < 0) {
+            throw std::invalid_argument("negative");
+        }
+    }
+
+    int value;
+};
+
+bool operator<(const Picky& a, const Picky& b) { return a.value < b.value; }
+bool operator==(const Picky& a, const Picky& b) { return a.value == b.value; }
+bool operator<(const Picky& a, int b) { return a.value < b; }
+bool operator==(const Picky& a, int b) { return a.value == b; }
+
+// prints what it took, and whether that was as many copies as it should have
+bool report(const std::string& what, int copies) {
+    std::cout << what << ": " << Counted::constructs << " constructed, "
+              << Counted::copies << " copied, " << Counted::moves << " moved\n";
+    bool asExpected = Counted::copies == copies;
+    Counted::reset();
+    return asExpected;
+}
+
+int main(void) {
+    // big enough nodes that nothing shuffles along inside them
+    bool ok = true;
+    btree<Counted> tree(100);
+    tree.insert(Counted(50));
+    Counted::reset();
+
+    Counted one(1);
+    Counted::reset();
+    tree.insert(one);
+    ok &= report("insert lvalue", 1);
+    tree.insert(one);
+    ok &= report("insert lvalue again", 0);
+
+    Counted two(2);
+    Counted::reset();
+    tree.insert(std::move(two));
+    ok &= report("insert rvalue", 0);
+
+    tree.emplace(3);
+    ok &= report("emplace", 0);
+    tree.emplace(3);
+    ok &= report("emplace again", 0);
+
+    tree.try_emplace(4);
+    ok &= report("try_emplace", 0);
+    auto result = tree.try_emplace(4);
+    ok &= report("try_emplace again", 0);
+    std::cout << result.second << " " << result.first->value << "\n";
+    ok &= !result.second && result.first->value == 4;
+
+    for (const auto& elem : tree) {
+        std::cout << elem.value << " ";
+    }
+    std::cout << "\n";
+    ok &= matches(tree, std::set<Counted>{1, 2, 3, 4, 50});
+
+    // strings are only made from the literal if they're needed
+    btree<std::string> bts(2);
+    bts.try_emplace("comp3000");
+    bts.try_emplace("comp6771");
+    bts.try_emplace("comp2000");
+    bts.try_emplace("comp1000");
+    bool again = bts.try_emplace("comp6771").second;
+    bool added = bts.emplace("comp9999").second;
+    std::cout << again << " " << added << " " << bts << "\n";
+    ok &= !again && added;
+
+    // an elem that can't be made leaves no node behind where it would have gone,
+    // whether that's a new root or a child spilled from a full node
+    btree<Picky> picky(1);
+    int thrown = 0;
+    for (int value : {-1, 5, -2, 7, -3}) {
+        try {
+            picky.try_emplace(value);
+        } catch (const std::invalid_argument&) {
+            ++thrown;
+        }
+        if (value == -1) {
+            bool empty = picky.begin() == picky.end();
+            bool matched = matches(picky, std::set<int>());
+            std::cout << "empty " << empty << " " << matched << "\n";
+            ok &= empty && matched;
+        }
+    }
+    bool matched = matches(picky, std::set<int>{5, 7});
+    bool verified = static_cast<bool>(btree_verify(picky, std::set<int>{5, 7}));
+    std::cout << thrown << " thrown, " << matched << " " << verified << " "
+              << picky.shape_report().node_count << " nodes\n";
+    ok &= thrown == 3 && matched && verified;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "btree_verify.h"
+#include "test_allocations.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(4184);
+
+// so the string trees below keep normalized prefixes that erase has to keep in step
+template <> struct btree_key_traits<std::string> : btree_string_prefix {};
+
+// erasing and inserting at random stays in step with std::set, copies included
+bool checkErase(btree<long>::size_type maxNodeElems, bool hashIndex) {
+    btree<long> tree(maxNodeElems);
+    tree.hash_index(hashIndex);
+    std::set<long> set;
+    btree<long> copy;
+    std::set<long> copySet;
+
+    for (int round = 0; round < 20000; ++round) {
+        long elem = rng.below(1000);
+        if (rng.below(2)) {
+            if (tree.insert(elem).second != set.insert(elem).second) {
+                return false;
+            }
+        } else if (tree.erase(elem) != set.erase(elem)) {
+            return false;
+        }
+        if (round % 5000 == 0) {
+            // erasing from the tree mustn't touch the nodes the copy shares
+            copy = tree;
+            copySet = set;
+        }
+        if (round % 1000 == 0) {
+            for (long elem = 0; elem < 1000; ++elem) {
+                if ((tree.find(elem) != tree.end()) != (set.count(elem) == 1)) {
+                    return false;
+                }
+            }
+        }
+    }
+    if (!matches(tree, set) || !matches(copy, copySet)) {
+        return false;
+    }
+
+    // and erasing everything leaves an empty tree that still works
+    for (long elem = 0; elem < 1000; ++elem) {
+        tree.erase(elem);
+    }
+    if (tree.begin() != tree.end() || tree.find(0) != tree.end()) {
+        return false;
+    }
+    tree.insert(7);
+    return matches(tree, std::set<long>{7}) && matches(copy, copySet);
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    bool ok = true;
+    ok &= check(checkErase(1, false));
+    ok &= check(checkErase(4, false));
+    ok &= check(checkErase(40, false));
+    ok &= check(checkErase(4, true));
+
+    // strings keep their normalized prefixes in step as elems move about
+    btree<std::string> words(3);
+    std::set<std::string> wordSet;
+    // some sharing their first eight bytes, so their prefixes tie
+    std::vector<std::string> all = {"pear", "apple", "fig", "plum", "kiwi", "lime", "date",
+                                    "apricot", "peach", "grape", "mango", "melon", "cherry",
+                                    "strawberry", "strawberries", "passionfruit", "passionflower",
+                                    "blackberry", "blackberries", "blackcurrant"};
+    for (const auto& word : all) {
+        words.insert(word);
+        wordSet.insert(word);
+    }
+    for (const auto& word : {"fig", "pear", "nothing", "apple", "strawberry", "melon", "passionflower"}) {
+        auto erased = words.erase(word);
+        std::cout << word << " " << erased << "\n";
+        ok &= erased == wordSet.erase(word);
+    }
+    bool found = true;
+    for (const auto& word : wordSet) {
+        found = found && words.find(word) != words.end();
+    }
+    bool matched = matches(words, wordSet);
+    bool pearGone = words.find("pear") == words.end();
+    std::cout << matched << " " << found << " " << pearGone << "\n";
+    ok &= matched && found && pearGone;
+    // which also checks every node's prefixes against its elems
+    ok &= check(static_cast<bool>(btree_verify(words, wordSet)));
+
+    // emptied nodes come back when the tree grows again, as many as the free list has room for
+    std::set<long> recycledSet;
+    for (long elem = 0; elem < 100; elem += 3) {
+        recycledSet.insert(elem);
+    }
+    for (btree<long>::size_type kept : {64, 2}) {
+        btree<long> recycled(2);
+        recycled.free_nodes(kept);
+        for (long elem = 0; elem < 100; ++elem) {
+            recycled.insert(elem);
+        }
+        for (long elem = 0; elem < 100; ++elem) {
+            recycled.erase(elem);
+        }
+        std::size_t before = allocations;
+        for (long elem = 0; elem < 100; elem += 3) {
+            recycled.insert(elem);
+        }
+        // 17 nodes needed: all of them reused, or all but 2 allocated
+        bool allReused = allocations - before == 0;
+        bool recycledMatches = matches(recycled, recycledSet);
+        std::cout << kept << " " << allReused << " " << recycledMatches << "\n";
+        ok &= allReused == (kept >= 17) && recycledMatches;
+    }
+
+    // and once a cycle of inserts and erases has run, running it again allocates nothing
+    for (btree<long>::size_type maxNodeElems : {3, 40}) {
+        btree<long> churned(maxNodeElems);
+        churned.free_nodes(4000);
+        for (long i = 0; i < 10000; ++i) {
+            churned.insert(2 * (i * 7919 % 100003));
+        }
+        std::size_t perCycle = 0;
+        for (int cycle = 0; cycle < 3; ++cycle) {
+            std::size_t before = allocations;
+            for (long i = 0; i < 2000; ++i) {
+                churned.insert(2 * (i * 4111 % 100003) + 1);
+            }
+            for (long i = 0; i < 2000; ++i) {
+                churned.erase(2 * (i * 4111 % 100003) + 1);
+            }
+            perCycle = allocations - before;
+        }
+        std::cout << maxNodeElems << " " << perCycle << " allocations\n";
+        ok &= perCycle == 0;
+    }
+
+    // a node emptied by an erase still comes out of the tree when there's no memory to keep it with
+    btree<long> starved(4);
+    for (long elem : {0, 1, 2, 3, 10}) {
+        starved.insert(elem);
+    }
+    bool erased = false;
+    failAllocations = true;
+    try {
+        // 10 is alone in the root's last child, which erasing it empties
+        erased = starved.erase(10) == 1;
+    } catch (const std::bad_alloc&) {
+    }
+    failAllocations = false;
+    bool starvedMatches = matches(starved, std::set<long>{0, 1, 2, 3});
+    bool verified = static_cast<bool>(btree_verify(starved, std::set<long>{0, 1, 2, 3}));
+    std::cout << erased << " " << starvedMatches << " " << verified << "\n";
+    ok &= erased && starvedMatches && verified;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#define BTREE_STATS
+
+#include <cstddef>
+#include <iostream>
+#include <set>
+
+#include <pthread.h>
+
+#include "btree.h"
+#include "test_util.h"
+
+// runs f on a thread whose stack is only stackBytes, so anything recursing a level per node overflows it
+template <typename F>
+void onSmallStack(std::size_t stackBytes, F f) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stackBytes);
+    pthread_t thread;
+    pthread_create(&thread, &attr, [](void* arg) -> void* {
+        (*static_cast<F*>(arg))();
+        return nullptr;
+    }, &f);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    bool ok = true;
+    // sorted input into single-elem nodes makes one long chain, which
+    // mustn't be torn down recursively
+    const long depth = 5000;
+    {
+        btree<long> chain(1);
+        for (long elem = 0; elem < depth; ++elem) {
+            chain.insert(elem);
+        }
+        btree<long> copy = chain;
+        chain.insert(depth);
+
+        // clearing one copy leaves the nodes the other shares alone
+        chain.clear();
+        bool cleared = chain.begin() == chain.end();
+        bool copyKept = copy.find(depth - 1) != copy.end();
+        std::cout << cleared << " " << copyKept << "\n";
+        ok &= cleared && copyKept;
+        chain.insert(5);
+        ok &= check(matches(chain, std::set<long>{5}));
+
+        // a recursive teardown of the chain needs far more stack than this
+        onSmallStack(64 * 1024, [&copy] {
+            btree<long> doomed = std::move(copy);
+        });
+    }
+    std::cout << "chain gone\n";
+
+    // clearing keeps the hash index on, emptied
+    btree<long> indexed(4);
+    indexed.hash_index(true);
+    for (long elem = 0; elem < 100; ++elem) {
+        indexed.insert(elem);
+    }
+    indexed.clear();
+    indexed.insert(42);
+    bool found = indexed.find(42) != indexed.end();
+    bool gone = indexed.find(7) == indexed.end();
+    std::cout << indexed.hash_index() << " " << found << " " << gone << "\n";
+    ok &= indexed.hash_index() && found && gone;
+
+    // reserving makes the free list big enough for the nodes needed
+    btree<long> reserved(10);
+    reserved.reserve(1000);
+    std::cout << reserved.free_nodes() << "\n";
+    std::set<long> set;
+    auto before = btree<long>::stats();
+    for (long elem = 0; elem < 1000; ++elem) {
+        reserved.insert(elem * 7 % 1000);
+        set.insert(elem * 7 % 1000);
+    }
+    auto inserting = btree<long>::stats() - before;
+    bool matched = matches(reserved, set);
+    std::cout << matched << " " << inserting.allocations << " allocations " << inserting.reuses
+              << " reuses\n";
+    ok &= matched && inserting.allocations == 0;
+
+    // nodes that hold nothing before spilling get a node an elem
+    btree<long> spilling(0);
+    spilling.reserve(100);
+    before = btree<long>::stats();
+    for (long elem = 0; elem < 100; ++elem) {
+        spilling.insert(elem * 7 % 100);
+    }
+    auto spilled = btree<long>::stats() - before;
+    std::cout << spilling.free_nodes() << " " << spilled.allocations << " allocations\n";
+    ok &= spilled.allocations == 0;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <set>
+#include <string>
+
+#include "btree_pmr.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+// keeps track of what's been allocated from it and not yet given back
+class counting_resource : public std::pmr::memory_resource {
+    public:
+        std::size_t allocations = 0;
+        std::size_t outstanding = 0;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++allocations;
+            outstanding += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+            outstanding -= bytes;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+};
+
+// a stateful allocator that goes along with a tree it's move-assigned from,
+// so two trees only share nodes if they came from the same arena
+template <typename T>
+struct arena_allocator {
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+
+    int arena;
+
+    explicit arena_allocator(int arena_): arena{arena_} {}
+    template <typename U>
+    arena_allocator(const arena_allocator<U>& other): arena{other.arena} {}
+
+    T* allocate(std::size_t n) { return std::allocator<T>().allocate(n); }
+    void deallocate(T* p, std::size_t n) { std::allocator<T>().deallocate(p, n); }
+};
+
+template <typename T, typename U>
+bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b) { return a.arena == b.arena; }
+template <typename T, typename U>
+bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b) { return !(a == b); }
+
+// move-assigns between trees on different arenas with the hash index on,
+// then uses both, so neither is left looking elems up in freed nodes
+bool checkPropagatingMove() {
+    using Tree = btree<long, arena_allocator<long>>;
+    Tree target(4, arena_allocator<long>(1));
+    Tree source(4, arena_allocator<long>(2));
+    target.hash_index(true);
+    source.hash_index(true);
+    std::set<long> targetSet;
+    std::set<long> sourceSet;
+    for (long elem = 0; elem < 500; ++elem) {
+        target.insert(elem * 3 % 500);
+        targetSet.insert(elem * 3 % 500);
+        source.insert(elem * 7 % 500 + 1000);
+        sourceSet.insert(elem * 7 % 500 + 1000);
+    }
+    target = std::move(source);
+    if (!matches(target, sourceSet) || target.get_allocator().arena != 2) {
+        return false;
+    }
+    // whatever the moved-from tree was left with, looking in it is safe
+    for (auto elem : targetSet) {
+        if (source.find(elem) != source.end() && *source.find(elem) != elem) {
+            return false;
+        }
+    }
+    source.clear();
+    source.insert(3);
+    target.insert(-1);
+    sourceSet.insert(-1);
+    return source.find(3) != source.end() && source.find(1003) == source.end() && matches(target, sourceSet);
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    bool ok = true;
+    counting_resource counted;
+    {
+        // nothing allocates from the default resource
+        std::pmr::set_default_resource(std::pmr::null_memory_resource());
+        pmr::btree<long> tree(4, &counted);
+        std::set<long> set;
+        for (int i = 0; i < 5000; ++i) {
+            long elem = rng.below(2000);
+            if (rng.below(3)) {
+                tree.insert(elem);
+                set.insert(elem);
+            } else {
+                tree.erase(elem);
+                set.erase(elem);
+            }
+        }
+        bool matched = matches(tree, set);
+        std::cout << matched << " " << (counted.allocations > 0) << "\n";
+        ok &= matched && counted.allocations > 0;
+
+        // copies on the same resource share nodes until they're written to
+        pmr::btree<long> copy(tree, &counted);
+        copy.insert(-1);
+        pmr::btree<long> assigned(4, &counted);
+        assigned = copy;
+        assigned.insert(-2);
+        std::set<long> copySet = set;
+        copySet.insert(-1);
+        bool originalKept = matches(tree, set);
+        bool copyMatched = matches(copy, copySet);
+        bool sameResource = assigned.get_allocator().resource() == &counted;
+        std::cout << originalKept << " " << copyMatched << " " << sameResource << "\n";
+        ok &= originalKept && copyMatched && sameResource;
+        std::pmr::set_default_resource(nullptr);
+    }
+    // and everything went back when the trees did
+    std::cout << counted.outstanding << "\n";
+    ok &= counted.outstanding == 0;
+
+    // moving a tree onto one with a different resource copies it, so nothing
+    // is left pointing into the source's resource once that's gone
+    counting_resource kept;
+    {
+        pmr::btree<long> target(4, &kept);
+        std::set<long> set;
+        {
+            std::pmr::monotonic_buffer_resource going;
+            pmr::btree<long> source(4, &going);
+            for (long elem = 0; elem < 500; ++elem) {
+                source.insert(elem * 7 % 500);
+                set.insert(elem * 7 % 500);
+            }
+            target = std::move(source);
+        }
+        bool copied = matches(target, set);
+        bool keptResource = target.get_allocator().resource() == &kept;
+        std::cout << copied << " " << keptResource << " ";
+        ok &= copied && keptResource;
+
+        // but on the same resource it just takes the nodes
+        pmr::btree<long> taker(4, &kept);
+        std::size_t before = kept.allocations;
+        taker = std::move(target);
+        bool taken = matches(taker, set);
+        std::cout << taken << " " << (kept.allocations == before) << "\n";
+        ok &= taken && kept.allocations == before;
+    }
+    std::cout << kept.outstanding << "\n";
+    ok &= kept.outstanding == 0;
+
+    // copying a tree off a different resource copies its nodes too, so the
+    // copies last when the source's resource goes
+    {
+        pmr::btree<long> assigned(4, &kept);
+        std::set<long> set;
+        std::unique_ptr<pmr::btree<long>> constructed;
+        {
+            std::pmr::monotonic_buffer_resource scratch;
+            pmr::btree<long> source(4, &scratch);
+            for (long elem = 0; elem < 500; ++elem) {
+                source.insert(elem * 7 % 500);
+                set.insert(elem * 7 % 500);
+            }
+            assigned = source;
+            constructed = std::make_unique<pmr::btree<long>>(source, &kept);
+        }
+        bool assignedMatched = matches(assigned, set);
+        bool constructedMatched = matches(*constructed, set);
+        std::cout << assignedMatched << " " << constructedMatched << " ";
+        ok &= assignedMatched && constructedMatched;
+        // and writing to them doesn't touch it either
+        assigned.insert(-1);
+        constructed->erase(0);
+        std::set<long> inserted = set;
+        inserted.insert(-1);
+        set.erase(0);
+        assignedMatched = matches(assigned, inserted);
+        constructedMatched = matches(*constructed, set);
+        std::cout << assignedMatched << " " << constructedMatched << "\n";
+        ok &= assignedMatched && constructedMatched;
+    }
+    std::cout << kept.outstanding << "\n";
+    ok &= kept.outstanding == 0;
+
+    // a whole tree's worth from a buffer that's dropped in one go
+    {
+        std::pmr::monotonic_buffer_resource monotonic;
+        pmr::btree<std::string> words(3, SearchPolicy::binary, &monotonic);
+        std::set<std::string> wordSet;
+        for (const auto& word : {"pear", "apple", "fig", "plum", "kiwi", "lime", "date", "apricot"}) {
+            words.insert(word);
+            wordSet.insert(word);
+        }
+        bool matched = matches(words, wordSet);
+        bool found = words.find("kiwi") != words.end();
+        std::cout << matched << " " << found << "\n";
+        ok &= matched && found;
+    }
+
+    // unequal allocators that propagate on move assignment
+    ok &= check(checkPropagatingMove());
+    return ok ? 0 : 1;
+}
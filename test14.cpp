@@ -0,0 +1,104 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <set>
+
+#include "btree_huge_pages.h"
+#include "btree_pmr.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+// passes everything on to upstream, keeping track of the blocks asked for with a cache line's alignment
+class recording_resource : public std::pmr::memory_resource {
+    public:
+        explicit recording_resource(std::pmr::memory_resource* upstream_): upstream{upstream_} {}
+
+        std::size_t lineAligned = 0;
+        bool allOnLines = true;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            void* p = upstream->allocate(bytes, alignment);
+            if (alignment == btree_huge_page_resource::alignment) {
+                ++lineAligned;
+                // the node after the control block only lands on a line if the block is whole lines
+                allOnLines = allOnLines && reinterpret_cast<std::uintptr_t>(p) % alignment == 0 && bytes % alignment == 0;
+            }
+            return p;
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+            upstream->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        std::pmr::memory_resource* upstream;
+};
+
+// how many of the tree's nodes were asked for padded out to whole cache lines, or -1 if any didn't get them
+template <typename Tree>
+long lineAlignedNodes() {
+    btree_huge_page_resource resource(false);
+    recording_resource recording(&resource);
+    {
+        Tree tree(8, SearchPolicy::binary, &recording);
+        for (long elem = 0; elem < 1000; ++elem) {
+            tree.insert(elem * 7919 % 1009);
+        }
+        Tree copy(tree, &recording);
+        copy.insert(-1);
+    }
+    return recording.allOnLines ? static_cast<long>(recording.lineAligned) : -1;
+}
+
+bool checkResource(bool hugePages) {
+    btree_huge_page_resource resource(hugePages);
+    pmr::btree<long> tree(8, SearchPolicy::binary, &resource);
+    std::set<long> set;
+    for (int i = 0; i < 50000; ++i) {
+        long elem = rng.below(20000);
+        if (rng.below(3)) {
+            tree.insert(elem);
+            set.insert(elem);
+        } else {
+            tree.erase(elem);
+            set.erase(elem);
+        }
+    }
+
+    // blocks are cache-line aligned, whatever was asked for
+    bool aligned = true;
+    for (std::size_t bytes : {1, 24, 64, 100, 4096}) {
+        void* p = resource.allocate(bytes, 8);
+        aligned = aligned && reinterpret_cast<std::uintptr_t>(p) % btree_huge_page_resource::alignment == 0;
+        resource.deallocate(p, bytes, 8);
+    }
+    // and big ones don't come from the slabs at all
+    void* big = resource.allocate(btree_huge_page_resource::slab_size, 64);
+    resource.deallocate(big, btree_huge_page_resource::slab_size, 64);
+
+    std::size_t slabs = resource.slab_count(btree_huge_page_resource::backing::huge_pages) +
+        resource.slab_count(btree_huge_page_resource::backing::transparent) +
+        resource.slab_count(btree_huge_page_resource::backing::aligned);
+    return matches(tree, set) && aligned && slabs > 0 &&
+        (hugePages || slabs == resource.slab_count(btree_huge_page_resource::backing::aligned));
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    bool ok = true;
+    ok &= check(checkResource(false));
+    ok &= check(checkResource(true));
+    // only trees that ask for it get their nodes lined up
+    bool aligned = lineAlignedNodes<pmr::line_aligned_btree<long>>() > 100;
+    auto unaligned = lineAlignedNodes<pmr::btree<long>>();
+    std::cout << aligned << " " << unaligned << "\n";
+    ok &= aligned && unaligned == 0;
+    return ok ? 0 : 1;
+}
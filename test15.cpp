@@ -0,0 +1,95 @@
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "btree.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+void fill(btree<long>& tree, std::set<long>& set, int count, long range) {
+    for (int i = 0; i < count; ++i) {
+        long elem = rng.below(range);
+        tree.insert(elem);
+        set.insert(elem);
+    }
+}
+
+// refreshing a replica from a master over and over, whichever way, keeps them apart
+bool checkRefresh(bool deep, bool masterIndex, bool replicaIndex) {
+    btree<long> master(4);
+    master.hash_index(masterIndex);
+    std::set<long> masterSet;
+    btree<long> replica(4);
+    replica.hash_index(replicaIndex);
+    std::set<long> replicaSet;
+    fill(replica, replicaSet, 300, 1000);
+    btree<long> sharer = replica;
+
+    for (int round = 0; round < 10; ++round) {
+        // the master grows and shrinks, so the replica's old shape fits it less and less
+        fill(master, masterSet, round % 2 ? 50 : 400, 2000);
+        for (int i = 0; i < 100; ++i) {
+            long elem = rng.below(2000);
+            master.erase(elem);
+            masterSet.erase(elem);
+        }
+
+        if (deep) {
+            replica.assign_from(master);
+        } else {
+            replica = master;
+        }
+        replicaSet = masterSet;
+        if (!matches(replica, replicaSet) || replica.hash_index() != masterIndex) {
+            return false;
+        }
+
+        // writes to either don't show up in the other
+        replica.insert(-1 - round);
+        replicaSet.insert(-1 - round);
+        master.insert(5000 + round);
+        masterSet.insert(5000 + round);
+        if (!matches(replica, replicaSet) || !matches(master, masterSet)) {
+            return false;
+        }
+    }
+    // and a tree that shared the replica's old nodes still has them
+    std::set<long> sharerSet;
+    for (auto elem : sharer) {
+        sharerSet.insert(elem);
+    }
+    return sharerSet.size() > 0 && matches(sharer, sharerSet);
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    bool ok = true;
+    for (bool deep : {false, true}) {
+        bool plain = checkRefresh(deep, false, false);
+        bool masterIndexed = checkRefresh(deep, true, false);
+        bool replicaIndexed = checkRefresh(deep, false, true);
+        bool bothIndexed = checkRefresh(deep, true, true);
+        std::cout << plain << " " << masterIndexed << " " << replicaIndexed << " " << bothIndexed << "\n";
+        ok &= plain && masterIndexed && replicaIndexed && bothIndexed;
+    }
+
+    // assigning from an empty tree, and to and from itself
+    btree<std::string> words(2);
+    for (const auto& word : {"pear", "apple", "fig", "plum", "kiwi"}) {
+        words.insert(word);
+    }
+    btree<std::string> copy(3);
+    copy.assign_from(words);
+    copy.assign_from(copy);
+    copy = copy;
+    bool matched = matches(copy, std::set<std::string>{"apple", "fig", "kiwi", "pear", "plum"});
+    std::cout << matched << " ";
+    copy.assign_from(btree<std::string>());
+    bool emptied = copy.begin() == copy.end();
+    std::cout << emptied << "\n";
+    ok &= matched && emptied;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "btree.h"
+#include "test_util.h"
+#include "workload.h"
+
+workload::Xoshiro256 rng(6771);
+
+// counts copies so we can see that moving between trees makes none
+struct Counted {
+    static int copies;
+
+    Counted(): value{0} {}
+    Counted(int value_): value{value_} {}
+    Counted(const Counted& other): value{other.value} { ++copies; }
+    Counted(Counted&& other) noexcept: value{other.value} {}
+    Counted& operator=(const Counted& other) { value = other.value; ++copies; return *this; }
+    Counted& operator=(Counted&& other) noexcept { value = other.value; return *this; }
+
+    int value;
+};
+
+int Counted::copies = 0;
+
+bool operator<(const Counted& a, const Counted& b) { return a.value < b.value; }
+bool operator==(const Counted& a, const Counted& b) { return a.value == b.value; }
+
+namespace std {
+template <>
+struct hash<Counted> {
+    std::size_t operator()(const Counted& c) const { return std::hash<int>()(c.value); }
+};
+}
+
+// moves elems from a hot tree to a cold one a few at a time, then merges the rest
+bool checkMigration(btree<Counted>::size_type maxNodeElems, bool hashIndex) {
+    btree<Counted> hot(maxNodeElems);
+    btree<Counted> cold(maxNodeElems);
+    hot.hash_index(hashIndex);
+    std::set<int> hotSet;
+    std::set<int> coldSet;
+    for (int i = 0; i < 2000; ++i) {
+        int value = rng.below(3000);
+        hot.insert(Counted(value));
+        hotSet.insert(value);
+        if (rng.below(4) == 0) {
+            value = rng.below(3000);
+            cold.insert(Counted(value));
+            coldSet.insert(value);
+        }
+    }
+
+    Counted::copies = 0;
+    for (int i = 0; i < 500; ++i) {
+        int value = rng.below(3000);
+        auto nh = hot.extract(Counted(value));
+        if (nh.empty() != (hotSet.erase(value) == 0)) {
+            return false;
+        }
+        if (nh.empty()) {
+            continue;
+        }
+        auto result = cold.insert(std::move(nh));
+        bool inserted = coldSet.insert(value).second;
+        if (result.inserted != inserted || result.position->value != value || result.node.empty() == !inserted ||
+            !nh.empty()) {
+            return false;
+        }
+    }
+    if (!matches(hot, hotSet) || !matches(cold, coldSet)) {
+        return false;
+    }
+
+    // whatever's left in hot that cold doesn't have yet
+    cold.merge(hot);
+    std::set<int> stays;
+    for (auto value : hotSet) {
+        if (!coldSet.insert(value).second) {
+            stays.insert(value);
+        }
+    }
+    return Counted::copies == 0 && matches(cold, coldSet) && matches(hot, stays);
+}
+
+int main(void) {
+    std::cout.setf(std::ios::boolalpha);
+
+    bool ok = true;
+    ok &= check(checkMigration(1, false));
+    ok &= check(checkMigration(4, false));
+    ok &= check(checkMigration(40, false));
+    ok &= check(checkMigration(4, true));
+
+    // an empty handle goes nowhere, and a handle can be put back where it came from
+    btree<std::string> words(2);
+    words.insert("pear");
+    words.insert("fig");
+    auto none = words.extract("plum");
+    auto result = words.insert(std::move(none));
+    bool atEnd = result.position == words.end();
+    std::cout << none.empty() << " " << result.inserted << " " << atEnd << "\n";
+    ok &= none.empty() && !result.inserted && atEnd;
+    auto fig = words.extract("fig");
+    bool taken = words.find("fig") == words.end();
+    std::cout << fig.value() << " " << taken << " ";
+    ok &= fig.value() == "fig" && taken;
+    words.insert(std::move(fig));
+    bool putBack = words.find("fig") != words.end();
+    std::cout << putBack << "\n";
+    ok &= putBack;
+
+    // merging a tree into a copy of itself moves nothing
+    btree<std::string> copy = words;
+    copy.merge(words);
+    words.merge(words);
+    bool stayed = words.find("pear") != words.end();
+    bool copyStayed = copy.find("fig") != copy.end();
+    std::cout << stayed << " " << copyStayed << "\n";
+    ok &= stayed && copyStayed;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#define BTREE_STATS
+
+#include <iostream>
+#include <string>
+
+#include "btree.h"
+
+// prints the counts, and whether they're the ones expected, which are given
+// in the same order: {comparisons, node visits, path pushes, spills, allocations, reuses}
+bool print(const std::string& what, const btree_stats& stats, const btree_stats& expected) {
+    std::cout << what << ": " << stats.comparisons << " comparisons, " << stats.node_visits << " node visits, "
+              << stats.path_pushes << " path pushes, " << stats.spills << " spills, "
+              << stats.allocations << " allocations, " << stats.reuses << " reuses\n";
+    return stats.comparisons == expected.comparisons && stats.node_visits == expected.node_visits &&
+           stats.path_pushes == expected.path_pushes && stats.spills == expected.spills &&
+           stats.allocations == expected.allocations && stats.reuses == expected.reuses;
+}
+
+int main(void) {
+    bool ok = true;
+    btree<long> tree(2);
+    btree<long>::reset_stats();
+
+    // 20 10 fill the root, then 5 spills into a new child to the left of 10
+    tree.insert(20);
+    tree.insert(10);
+    ok &= print("two into the root", btree<long>::stats(), {2, 2, 0, 0, 1, 0});
+    auto before = btree<long>::stats();
+    tree.insert(5);
+    ok &= print("one more spills", btree<long>::stats() - before, {2, 1, 1, 1, 1, 0});
+
+    before = btree<long>::stats();
+    tree.find(5);
+    ok &= print("find in the child", btree<long>::stats() - before, {4, 2, 1, 0, 0, 0});
+
+    before = btree<long>::stats();
+    tree.find(15);
+    ok &= print("find a miss", btree<long>::stats() - before, {3, 2, 0, 0, 0, 0});
+
+    before = btree<long>::stats();
+    long sum = 0;
+    for (auto elem : tree) {
+        sum += elem;
+    }
+    ok &= print("iterate " + std::to_string(sum), btree<long>::stats() - before, {0, 3, 1, 0, 0, 0});
+
+    // erasing leaves an empty child to reuse
+    tree.erase(5);
+    before = btree<long>::stats();
+    tree.insert(7);
+    ok &= print("spill into a reused node", btree<long>::stats() - before, {2, 1, 1, 1, 0, 1});
+
+    btree<long>::reset_stats();
+    ok &= print("reset", btree<long>::stats(), {});
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include <cstddef>
+#include <iostream>
+
+#include "btree.h"
+#include "workload.h"
+
+void printPath(const btree_shape& shape) {
+    std::cout << "longest path";
+    for (auto index : shape.longest_path) {
+        std::cout << " " << index;
+    }
+    std::cout << "\n";
+}
+
+int main(void) {
+    // an empty tree has no shape at all
+    bool ok = true;
+    btree<long> empty;
+    std::cout << empty.shape_report();
+    ok &= empty.shape_report().node_count == 0 && empty.shape_report().height == 0;
+
+    // sorted input makes a chain of full nodes, each the last child of the one before
+    btree<long> sorted(4);
+    for (long elem = 0; elem < 20; ++elem) {
+        sorted.insert(elem);
+    }
+    auto shape = sorted.shape_report();
+    std::cout << shape;
+    printPath(shape);
+    ok &= shape.node_count == 5 && shape.elem_count == 20 && shape.height == 5 && shape.longest_chain == 4;
+
+    // filling the root first and then the gaps either side of its elems spreads things out
+    btree<long> spread(3);
+    for (long elem : {20, 40, 60, 10, 30, 50, 70, 5, 15, 25, 35, 45, 55, 65, 75, 1}) {
+        spread.insert(elem);
+    }
+    shape = spread.shape_report();
+    std::cout << shape;
+    printPath(shape);
+    ok &= shape.node_count == 6 && shape.elem_count == 16 && shape.height == 3 && shape.longest_chain == 1;
+
+    // and the report agrees with what's in the tree
+    btree<long> shuffled(8);
+    std::size_t inserted = 0;
+    workload::Xoshiro256 rng(6771);
+    for (int i = 0; i < 10000; ++i) {
+        inserted += shuffled.insert(rng.below(5000)).second;
+    }
+    shape = shuffled.shape_report();
+    std::size_t levelNodes = 0;
+    for (const auto& level : shape.levels) {
+        levelNodes += level.nodes;
+    }
+    std::cout.setf(std::ios::boolalpha);
+    bool elemsAgree = shape.elem_count == inserted;
+    bool nodesAgree = levelNodes == shape.node_count;
+    bool pathAgrees = shape.longest_path.size() == shape.max_leaf_depth;
+    bool heightAgrees = shape.height == shape.max_leaf_depth + 1;
+    std::cout << elemsAgree << " " << nodesAgree << " " << pathAgrees << " " << heightAgrees << "\n";
+    ok &= elemsAgree && nodesAgree && pathAgrees && heightAgrees;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "btree.h"
+
+// whether the percentiles are in order, which is all that can be said of real timings
+bool ordered(const btree_latency_summary& summary) {
+    return summary.p50 <= summary.p99 && summary.p99 <= summary.p999 && summary.p999 <= summary.max;
+}
+
+int main(void) {
+    std::cout << std::boolalpha;
+    bool ok = true;
+
+    // 1..1000 ticks: the p50 bucket holds 500, and is at most 1/8 wide
+    btree_latency_histogram histogram;
+    for (std::uint64_t ticks = 1; ticks <= 1000; ++ticks) {
+        histogram.record(ticks);
+    }
+    auto p50 = histogram.percentile(0.5);
+    bool p50Close = p50 >= 500 && p50 <= 500 + 500 / 8;
+    std::cout << "histogram count " << histogram.count() << " max " << histogram.max() << " p50 close "
+              << p50Close << " p100 " << histogram.percentile(1) << "\n";
+    ok &= histogram.count() == 1000 && histogram.max() == 1000 && p50Close;
+
+    btree<long> tree(8);
+    for (long i = 0; i < 100; ++i) {
+        tree.insert(i * 7 % 100);
+    }
+    std::cout << "off: sampling " << tree.latency_sampling() << " finds " << tree.latency(TimedOp::find).count << "\n";
+    ok &= tree.latency_sampling() == 0 && tree.latency(TimedOp::find).count == 0;
+
+    // every op timed
+    tree.latency_sampling(1);
+    for (long i = 0; i < 1000; ++i) {
+        tree.insert(i);
+    }
+    for (long i = 0; i < 500; ++i) {
+        tree.find(i * 3);
+    }
+    for (long i = 0; i < 10; ++i) {
+        tree.erase(i);
+    }
+    auto inserts = tree.latency(TimedOp::insert);
+    auto finds = tree.latency(TimedOp::find);
+    auto erases = tree.latency(TimedOp::erase);
+    bool allOrdered = ordered(inserts) && ordered(finds);
+    std::cout << "every: inserts " << inserts.count << " finds " << finds.count << " erases "
+              << erases.count << " ordered " << allOrdered << "\n";
+    ok &= inserts.count == 1000 && finds.count == 500 && erases.count == 10 && allOrdered;
+
+    // one in ten, starting afresh
+    tree.latency_sampling(10);
+    for (long i = 0; i < 1000; ++i) {
+        tree.find(i);
+    }
+    std::cout << "one in ten: sampling " << tree.latency_sampling() << " finds " << tree.latency(TimedOp::find).count
+              << " inserts " << tree.latency(TimedOp::insert).count << "\n";
+    ok &= tree.latency_sampling() == 10 && tree.latency(TimedOp::find).count == 100 &&
+          tree.latency(TimedOp::insert).count == 0;
+
+    // each thread records for itself, and they're merged on the way out
+    tree.latency_sampling(1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&tree] {
+            const btree<long>& reader = tree;
+            for (long i = 0; i < 250; ++i) {
+                reader.find(i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    finds = tree.latency(TimedOp::find);
+    std::cout << "threads: finds " << finds.count << " ordered " << ordered(finds) << "\n";
+    ok &= finds.count == 1000 && ordered(finds);
+
+    // trees on the same thread count down separately, each at its own rate
+    btree<long> halves(8), thirds(8);
+    halves.latency_sampling(2);
+    thirds.latency_sampling(3);
+    for (long i = 0; i < 600; ++i) {
+        halves.find(i);
+        thirds.find(i);
+    }
+    std::cout << "two trees: finds " << halves.latency(TimedOp::find).count << " and "
+              << thirds.latency(TimedOp::find).count << "\n";
+    ok &= halves.latency(TimedOp::find).count == 300 && thirds.latency(TimedOp::find).count == 200;
+
+    btree<long> copy = tree;
+    std::cout << "copy: sampling " << copy.latency_sampling() << "\n";
+    ok &= copy.latency_sampling() == 0;
+
+    tree.reset_latency();
+    std::cout << "reset: finds " << tree.latency(TimedOp::find).count << "\n";
+    ok &= tree.latency(TimedOp::find).count == 0;
+    tree.latency_sampling(0);
+    std::cout << "off again: sampling " << tree.latency_sampling() << "\n";
+    ok &= tree.latency_sampling() == 0;
+    return ok ? 0 : 1;
+}
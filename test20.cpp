@@ -0,0 +1,94 @@
+/**
+ * Counts the heap allocations each kind of operation makes (see
+ * test_allocations.h), and checks them against budgets so that a change
+ * which starts allocating where it didn't shows up here. Every operation
+ * is measured over many calls on a tree of 10000 elems and reported per
+ * call.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "btree.h"
+#include "test_allocations.h"
+
+namespace {
+
+const long kNumElems = 10000;
+const long kModulus = 100003;
+
+// somewhere in [0, kModulus) for each i, scattered so the tree is bushy
+long key(long i) {
+    return i * 7919 % kModulus;
+}
+
+// discards everything, without allocating somewhere to put it
+struct Discard : std::streambuf {
+    int overflow(int c) override { return c; }
+};
+
+/**
+ * Runs op ops times and prints the allocations and bytes per call,
+ * and whether they're within budget.
+ */
+template <typename Op>
+bool measure(const std::string& name, long ops, double allocationBudget, double byteBudget, Op op) {
+    std::size_t allocationsBefore = allocations;
+    std::size_t bytesBefore = allocatedBytes;
+    for (long i = 0; i < ops; ++i) {
+        op(i);
+    }
+    double perOp = double(allocations - allocationsBefore) / ops;
+    double bytesPerOp = double(allocatedBytes - bytesBefore) / ops;
+    bool within = perOp <= allocationBudget && bytesPerOp <= byteBudget;
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << perOp << " allocations" << std::setw(12) << bytesPerOp << " bytes"
+              << (within ? "" : "  OVER BUDGET") << "\n";
+    return within;
+}
+
+}  // namespace
+
+int main(void) {
+    // the budgets are about what each op costs today: paths down the tree
+    // fit in the iterators, so only inserts growing a node allocate;
+    // copies allocate a root and its control block, and operator<< grows a queue
+    btree<long> tree(40);
+    bool ok = true;
+
+    ok &= measure("insert", kNumElems, 1, 64, [&](long i) { tree.insert(key(i)); });
+    ok &= measure("insert dup", kNumElems, 0, 0, [&](long i) { tree.insert(key(i)); });
+    ok &= measure("find hit", kNumElems, 0, 0, [&](long i) { tree.find(key(i)); });
+    ok &= measure("find miss", kNumElems, 0, 0, [&](long i) { tree.find(key(i) + kModulus); });
+
+    // one step at a time, from one end to the other
+    auto forward = tree.begin();
+    ok &= measure("++", kNumElems - 1, 0.01, 1, [&](long) { ++forward; });
+    auto backward = tree.end();
+    ok &= measure("--", kNumElems, 0.01, 1, [&](long) { --backward; });
+    std::cout << "ends " << *forward << " " << *backward << "\n";
+
+    ok &= measure("begin", 100, 0, 0, [&](long) { tree.begin(); });
+    ok &= measure("end", 100, 0, 0, [&](long) { tree.end(); });
+    ok &= measure("it copy", 100, 0, 0, [&](long) {
+        auto copy = forward;
+        ++copy;
+    });
+
+    ok &= measure("copy", 100, 10, 3200, [&](long) {
+        btree<long> copy(tree);
+        copy.find(0);
+    });
+    ok &= measure("copy + write", 100, 18, 6400, [&](long i) {
+        btree<long> copy(tree);
+        copy.insert(kModulus + i);
+    });
+
+    Discard discard;
+    std::ostream out(&discard);
+    ok &= measure("operator<<", 10, 32, 16384, [&](long) { out << tree; });
+
+    std::cout << (ok ? "all within budget" : "over budget") << "\n";
+    return ok ? 0 : 1;
+}
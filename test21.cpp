@@ -0,0 +1,132 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "btree_trace.h"
+
+// the tree's contents in order, for comparing two trees
+template <typename T>
+std::string contents(const btree<T>& tree) {
+    std::ostringstream out;
+    for (const auto& elem : tree) {
+        out << elem << " ";
+    }
+    return out.str();
+}
+
+int main(void) {
+    std::cout << std::boolalpha;
+    bool ok = true;
+
+    // record some longs, some of them negative, through a recorder
+    btree<long> tree(4);
+    tree.insert(500);
+    std::stringstream trace;
+    long scanned = 0;
+    {
+        btree_trace_recorder<long> recorder(tree, trace);
+        for (long i = 0; i < 200; ++i) {
+            recorder.insert(i * 37 % 101 - 50);
+        }
+        for (long i = -60; i < 60; i += 7) {
+            recorder.find(i);
+        }
+        recorder.scan(-10, 20, [&](long elem) { scanned += elem; });
+        recorder.scan(45, 100, [&](long elem) { scanned += elem; });
+        for (long i = -50; i < 0; ++i) {
+            recorder.erase(i);
+        }
+        std::cout << "recorded " << recorder.records() << " records in " << trace.str().size() << " bytes, scanned "
+                  << scanned << "\n";
+    }
+    std::cout << "key kind " << btree_trace_format::key_kind(trace) << "\n";
+
+    // read it back and do it all again to a tree of a different shape
+    btree_trace_reader<long> reader(trace);
+    btree<long> replayed(32, SearchPolicy::binary);
+    btree_trace_record<long> record;
+    std::size_t counts[4] = {};
+    std::size_t results = 0;
+    while (reader.next(record)) {
+        ++counts[static_cast<int>(record.op)];
+        results += btree_trace_apply(replayed, record);
+    }
+    std::cout << "inserts " << counts[0] << " finds " << counts[1] << " scans " << counts[2] << " erases "
+              << counts[3] << " results " << results << "\n";
+    // the 500 already in the tree comes first, as an insert
+    ok &= counts[0] == 201 && counts[1] == 18 && counts[2] == 2 && counts[3] == 50;
+    bool sameContents = contents(tree) == contents(replayed);
+    std::cout << "same contents " << sameContents << "\n";
+    ok &= sameContents;
+
+    // what's in the tree to start with is replayed level by level, so it comes out the same shape
+    btree<long> wide(40);
+    for (long i = 0; i < 5000; ++i) {
+        wide.insert(i * 7919 % 10007);
+    }
+    std::stringstream wideTrace;
+    {
+        btree_trace_recorder<long> recorder(wide, wideTrace);
+    }
+    btree_trace_reader<long> wideReader(wideTrace);
+    btree<long> wideReplayed(40);
+    while (wideReader.next(record)) {
+        btree_trace_apply(wideReplayed, record);
+    }
+    std::ostringstream wideLevels, replayedLevels;
+    wideLevels << wide;
+    replayedLevels << wideReplayed;
+    bool sameLevels = wideLevels.str() == replayedLevels.str();
+    std::cout << "height " << wide.shape_report().height << " replayed "
+              << wideReplayed.shape_report().height << " same levels " << sameLevels << "\n";
+    ok &= sameLevels && wide.shape_report().height == wideReplayed.shape_report().height;
+
+    // strings share prefixes with the key before
+    std::stringstream words;
+    btree<std::string> wordTree;
+    {
+        btree_trace_recorder<std::string> recorder(wordTree, words);
+        for (const char* word : {"ABACUS", "ABACUSES", "ABALONE", "ZEBRA", "", "ABA"}) {
+            recorder.insert(word);
+        }
+        recorder.find("ABALONE");
+        recorder.erase("ZEBRA");
+    }
+    std::cout << "words in " << words.str().size() << " bytes, key kind " << btree_trace_format::key_kind(words)
+              << "\n";
+    btree_trace_reader<std::string> wordReader(words);
+    btree<std::string> wordReplayed;
+    btree_trace_record<std::string> wordRecord;
+    while (wordReader.next(wordRecord)) {
+        btree_trace_apply(wordReplayed, wordRecord);
+    }
+    bool sameWords = contents(wordTree) == contents(wordReplayed);
+    std::cout << "same words " << sameWords << "\n";
+    ok &= sameWords;
+
+    // the wrong kind of key, and a trace cut short
+    try {
+        words.clear();
+        words.seekg(0);
+        btree_trace_reader<long> wrong(words);
+        std::cout << "wrong kind not caught\n";
+        ok = false;
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << "\n";
+    }
+    // the header, an op and half a key
+    std::string cut = trace.str().substr(0, 8);
+    std::istringstream truncated(cut);
+    try {
+        btree_trace_reader<long> shortReader(truncated);
+        while (shortReader.next(record)) {
+        }
+        std::cout << "truncation not caught\n";
+        ok = false;
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << "\n";
+    }
+    return ok ? 0 : 1;
+}
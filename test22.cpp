@@ -0,0 +1,83 @@
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "btree_verify.h"
+
+// prints what the verifier found, and whether it passed or failed the tree as it should have
+bool print(const std::string& what, const btree_verify_result& result, bool shouldPass) {
+    std::cout << what << ": " << (result ? "ok" : result.problem) << " (" << result.elems << " elems, "
+              << result.nodes << " nodes, depth " << result.max_depth << ")\n";
+    return static_cast<bool>(result) == shouldPass;
+}
+
+int main(void) {
+    bool ok = true;
+    btree<long> tree(8);
+    std::set<long> reference;
+    for (long i = 0; i < 20000; ++i) {
+        long key = i * 7919 % 100003;
+        tree.insert(key);
+        reference.insert(key);
+    }
+    ok &= print("random", btree_verify(tree, reference, 4), true);
+    ok &= print("one thread", btree_verify(tree, reference, 1), true);
+
+    // a sorted vector does as well as a set
+    std::vector<long> sorted(reference.begin(), reference.end());
+    ok &= print("sorted vector", btree_verify(tree, sorted, 4), true);
+
+    // erasing from the middle of nodes leaves gaps filled from below
+    for (long i = 0; i < 20000; i += 3) {
+        long key = i * 7919 % 100003;
+        tree.erase(key);
+        reference.erase(key);
+    }
+    ok &= print("after erases", btree_verify(tree, reference, 4), true);
+
+    // differences either way
+    auto extra = reference;
+    extra.insert(100004);
+    ok &= print("reference has more", btree_verify(tree, extra, 4), false);
+    auto fewer = reference;
+    fewer.erase(std::next(fewer.begin(), 5000));
+    ok &= print("reference has less", btree_verify(tree, fewer, 4), false);
+    auto shifted = reference;
+    shifted.erase(std::prev(shifted.end()));
+    shifted.insert(-1);
+    ok &= print("reference differs", btree_verify(tree, shifted, 4), false);
+
+    // copies share nodes, and the hash index has to agree too
+    btree<long> copy = tree;
+    copy.hash_index(true);
+    copy.insert(100005);
+    reference.insert(100005);
+    ok &= print("copy with hash index", btree_verify(copy, reference, 4), true);
+
+    // sorted input makes one long chain, which can't be split up much
+    btree<long> chain(4);
+    std::set<long> chainReference;
+    for (long i = 0; i < 2000; ++i) {
+        chain.insert(i);
+        chainReference.insert(i);
+    }
+    ok &= print("chain", btree_verify(chain, chainReference, 8), true);
+
+    // strings have prefixes to check
+    btree<std::string> words(5);
+    std::set<std::string> wordReference;
+    for (const char* word : {"PEAR", "APPLE", "FIG", "APRICOT", "PLUM", "DATE", "LIME", "KIWI", "APPLES", "A"}) {
+        words.insert(word);
+        wordReference.insert(word);
+    }
+    ok &= print("words", btree_verify(words, wordReference, 2), true);
+    wordReference.insert("ZEBRA");
+    ok &= print("words missing one", btree_verify(words, wordReference, 2), false);
+
+    btree<long> empty;
+    ok &= print("empty", btree_verify(empty, std::set<long>(), 2), true);
+    ok &= print("empty but shouldn't be", btree_verify(empty, std::set<long>{1}, 2), false);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+/**
+ * Replaces the global operator new and delete so that a test can count
+ * its heap allocations, or make them fail. Only one file of a program may
+ * include it.
+ */
+
+#ifndef TEST_ALLOCATIONS_H
+#define TEST_ALLOCATIONS_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// what's been allocated since the program started
+std::size_t allocations = 0;
+std::size_t allocatedBytes = 0;
+
+// while set, every allocation throws std::bad_alloc
+bool failAllocations = false;
+
+void* allocate(std::size_t size) {
+    if (failAllocations) {
+        throw std::bad_alloc();
+    }
+    ++allocations;
+    allocatedBytes += size;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#endif
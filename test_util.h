@@ -0,0 +1,99 @@
+/**
+ * What the tests have in common.
+ */
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <iostream>
+#include <set>
+
+/**
+ * Prints whether a check passed on a line of its own, and passes it on so
+ * that main can return 1 if any check failed: ok &= check(...).
+ */
+inline bool check(bool passed) {
+    std::cout << passed << "\n";
+    return passed;
+}
+
+/**
+ * The tree holds exactly what the set holds, forwards and backwards, and
+ * finds all of it. Tree can be any btree whose elems compare equal to the
+ * set's, converting them if need be.
+ */
+template <typename Tree, typename T>
+bool matches(const Tree& tree, const std::set<T>& set) {
+    auto setIt = set.begin();
+    for (const auto& elem : tree) {
+        if (setIt == set.end() || !(elem == *setIt++)) {
+            return false;
+        }
+    }
+    auto setRit = set.rbegin();
+    for (auto it = tree.crbegin(); it != tree.crend(); ++it) {
+        if (setRit == set.rend() || !(*it == *setRit++)) {
+            return false;
+        }
+    }
+    for (const auto& elem : set) {
+        if (tree.find(elem) == tree.end()) {
+            return false;
+        }
+    }
+    return setIt == set.end() && setRit == set.rend();
+}
+
+/**
+ * Inserts count elems made by makeElem into both the tree and the set,
+ * returning whether the tree always agreed with the set about which were
+ * new.
+ */
+template <typename Tree, typename T, typename F>
+bool fillBoth(Tree& tree, std::set<T>& set, int count, F makeElem) {
+    bool agreed = true;
+    for (int i = 0; i < count; ++i) {
+        T elem = makeElem();
+        agreed = tree.insert(elem).second == set.insert(elem).second && agreed;
+    }
+    return agreed;
+}
+
+/**
+ * finder (a tree, or an index over one) finds exactly what the set finds:
+ * every elem of the set, and count probes made by makeProbe, are found if
+ * and only if the set has them, and the iterators found carry on through
+ * the elems as the set's do.
+ */
+template <typename Finder, typename T, typename F>
+bool findsLikeSet(const Finder& finder, const std::set<T>& set, int count, F makeProbe) {
+    auto findsLike = [&](const T& elem) {
+        auto it = finder.find(elem);
+        auto setIt = set.find(elem);
+        if ((it != finder.end()) != (setIt != set.end())) {
+            return false;
+        }
+        if (it == finder.end()) {
+            return true;
+        }
+        if (!(*it == *setIt)) {
+            return false;
+        }
+        ++it;
+        ++setIt;
+        return (it != finder.end()) == (setIt != set.end()) && (setIt == set.end() || *it == *setIt);
+    };
+    for (const auto& elem : set) {
+        if (!findsLike(elem)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        if (!findsLike(makeProbe())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
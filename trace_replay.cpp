@@ -0,0 +1,252 @@
+/**
+ * Replays a trace recorded with btree_trace_recorder (see btree_trace.h)
+ * against trees with each combination of fanout, search policy and
+ * allocator asked for, and reports how each one did.
+ *
+ *     g++ -std=c++17 -O2 -DNDEBUG trace_replay.cpp -o trace_replay
+ *     ./trace_replay workload.trc [fanouts] [policies] [allocators]
+ *     ./trace_replay --record sample.trc [ops]
+ *
+ * fanouts is a comma-separated list of maxNodeElems (default 4,16,64,256),
+ * policies of linear, binary and interpolation (default all three), and
+ * allocators of std (the global allocator), pool (a std::pmr pool) and
+ * huge (btree_huge_page_resource, each node on cache lines of its own);
+ * default all three. --record writes a made-up trace of long keys to try
+ * things out on.
+ *
+ * Each configuration runs the whole trace twice, from an empty tree: once
+ * straight through for the throughput, and once timing every operation on
+ * its own for the latencies, since reading the clock twice an op would
+ * otherwise be a good part of what's measured.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "btree.h"
+#include "btree_huge_pages.h"
+#include "btree_latency.h"
+#include "btree_pmr.h"
+#include "btree_trace.h"
+#include "workload.h"
+
+namespace {
+
+const char* const kOpNames[] = {"insert", "find", "scan", "erase"};
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+// whether every name is one of the known ones, saying which aren't if not
+bool allKnown(const std::vector<std::string>& names, const std::vector<std::string>& known, const std::string& what) {
+    bool ok = true;
+    for (const auto& name : names) {
+        if (std::find(known.begin(), known.end(), name) == known.end()) {
+            std::cerr << "unknown " << what << " '" << name << "'\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// a whole number above zero, all digits, so "4x" isn't quietly taken as 4
+bool parseCount(const std::string& text, std::size_t& count) {
+    if (text.empty() || !std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return false;
+    }
+    try {
+        count = std::stoul(text);
+    } catch (const std::out_of_range&) {
+        return false;
+    }
+    return count > 0;
+}
+
+// each of texts as a count, saying which aren't if not
+bool allCounts(const std::vector<std::string>& texts, const std::string& what, std::vector<std::size_t>& counts) {
+    bool ok = true;
+    for (const auto& text : texts) {
+        std::size_t count;
+        if (parseCount(text, count)) {
+            counts.push_back(count);
+        } else {
+            std::cerr << "bad " << what << " '" << text << "'\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+template <typename T>
+std::vector<btree_trace_record<T>> load(std::istream& in) {
+    btree_trace_reader<T> reader(in);
+    std::vector<btree_trace_record<T>> records;
+    btree_trace_record<T> record;
+    while (reader.next(record)) {
+        records.push_back(record);
+    }
+    return records;
+}
+
+template <typename Tree, typename T>
+void replay(const std::string& name, const std::vector<btree_trace_record<T>>& records, Tree& tree) {
+    double ns = bench::timeNs([&] {
+        for (const auto& record : records) {
+            bench::doNotOptimise(btree_trace_apply(tree, record));
+        }
+    });
+    bench::report(name, records.size(), ns);
+}
+
+template <typename Tree, typename T>
+void time(const std::vector<btree_trace_record<T>>& records, Tree& tree) {
+    btree_latency_histogram histograms[4];
+    for (const auto& record : records) {
+        std::uint64_t start = btree_latency_clock::now();
+        bench::doNotOptimise(btree_trace_apply(tree, record));
+        std::uint64_t stop = btree_latency_clock::now();
+        histograms[static_cast<int>(record.op)].record(stop - start);
+    }
+    for (int op = 0; op < 4; ++op) {
+        if (histograms[op].count() == 0) {
+            continue;
+        }
+        std::cout << "    " << kOpNames[op] << " " << histograms[op].summary() << "\n";
+    }
+}
+
+// both runs of one configuration, each on a tree of its own from a resource of its own
+template <typename T>
+void run(const std::vector<btree_trace_record<T>>& records, std::size_t fanout, const std::string& policyName,
+         SearchPolicy policy, const std::string& allocator) {
+    std::string name = "fanout=" + std::to_string(fanout) + " " + policyName + " " + allocator;
+    for (int timed = 0; timed < 2; ++timed) {
+        auto go = [&](auto& tree) {
+            if (timed) {
+                time(records, tree);
+            } else {
+                replay(name, records, tree);
+            }
+        };
+        if (allocator == "std") {
+            btree<T> tree(fanout, policy);
+            go(tree);
+        } else if (allocator == "pool") {
+            std::pmr::unsynchronized_pool_resource resource;
+            pmr::btree<T> tree(fanout, policy, &resource);
+            go(tree);
+        } else {
+            btree_huge_page_resource resource;
+            pmr::line_aligned_btree<T> tree(fanout, policy, &resource);
+            go(tree);
+        }
+    }
+}
+
+template <typename T>
+void runAll(std::istream& in, const std::vector<std::size_t>& fanouts, const std::vector<std::string>& policies,
+            const std::vector<std::string>& allocators) {
+    auto records = load<T>(in);
+    std::cout << records.size() << " records\n";
+    for (const auto& fanout : fanouts) {
+        for (const auto& policyName : policies) {
+            SearchPolicy policy = policyName == "binary"          ? SearchPolicy::binary
+                                  : policyName == "interpolation" ? SearchPolicy::interpolation
+                                                                  : SearchPolicy::linear;
+            for (const auto& allocator : allocators) {
+                run(records, fanout, policyName, policy, allocator);
+            }
+        }
+    }
+}
+
+// half finds, with inserts, erases and short scans, over a million keys
+void record(const std::string& path, std::size_t ops) {
+    std::ofstream out(path, std::ios::binary);
+    btree<long> tree;
+    btree_trace_recorder<long> recorder(tree, out);
+    workload::Xoshiro256 rng(6771);
+    for (std::size_t i = 0; i < ops; ++i) {
+        long key = rng.between(0, 1000000);
+        long dice = rng.between(0, 99);
+        if (dice < 50) {
+            recorder.find(key);
+        } else if (dice < 80) {
+            recorder.insert(key);
+        } else if (dice < 90) {
+            recorder.scan(key, rng.between(1, 100), [](long elem) { bench::doNotOptimise(elem); });
+        } else {
+            recorder.erase(key);
+        }
+    }
+    std::cout << recorder.records() << " records written to " << path << "\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " trace [fanouts] [policies] [allocators]\n"
+                  << "       " << argv[0] << " --record trace [ops]\n";
+        return 1;
+    }
+    std::string first = argv[1];
+    if (first == "--record") {
+        if (argc < 3) {
+            std::cerr << "--record needs somewhere to write the trace\n";
+            return 1;
+        }
+        std::size_t ops = 1000000;
+        if (argc > 3 && !parseCount(argv[3], ops)) {
+            std::cerr << "bad op count '" << argv[3] << "'\n"
+                      << "usage: " << argv[0] << " --record trace [ops]\n";
+            return 1;
+        }
+        record(argv[2], ops);
+        return 0;
+    }
+
+    std::ifstream in(first, std::ios::binary);
+    if (!in) {
+        std::cerr << "can't open " << first << "\n";
+        return 1;
+    }
+    // a typo would otherwise run (and be reported as) some other configuration
+    std::vector<std::size_t> fanouts;
+    bool fanoutsKnown = allCounts(split(argc > 2 ? argv[2] : "4,16,64,256"), "fanout", fanouts);
+    auto policies = split(argc > 3 ? argv[3] : "linear,binary,interpolation");
+    auto allocators = split(argc > 4 ? argv[4] : "std,pool,huge");
+    bool policiesKnown = allKnown(policies, {"linear", "binary", "interpolation"}, "policy");
+    bool allocatorsKnown = allKnown(allocators, {"std", "pool", "huge"}, "allocator");
+    if (!fanoutsKnown || !policiesKnown || !allocatorsKnown) {
+        std::cerr << "usage: " << argv[0] << " trace [fanouts] [policies] [allocators]\n"
+                  << "fanouts are whole numbers above zero; policies are linear, binary and interpolation;\n"
+                  << "allocators are std, pool and huge\n";
+        return 1;
+    }
+    try {
+        if (btree_trace_format::key_kind(in) == 's') {
+            runAll<std::string>(in, fanouts, policies, allocators);
+        } else {
+            runAll<long>(in, fanouts, policies, allocators);
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << first << ": " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,298 @@
+/**
+ * Random numbers and keys for the benchmarks and tests, in place of
+ * srandom()/random(): faster, unbiased, and reproducible from a seed
+ * whichever thread draws them.
+ *
+ * Xoshiro256 (xoshiro256**, seeded through SplitMix64) is the generator.
+ * It keeps no state outside itself, so threads each make their own; give
+ * each one a different stream, and their numbers come from stretches of
+ * the sequence 2^128 apart:
+ *
+ *     workload::Xoshiro256 rng(seed, threadIndex);
+ *     auto keys = workload::uniform(rng, 1000000, 0, 100000000);
+ *
+ * Key generators return keys in the order they'd be inserted:
+ *
+ * uniform     evenly over [low, high]
+ * zipf        a few keys over and over, most hardly ever (Zipf-distributed
+ *             ranks, scattered over [low, high])
+ * clustered   bunched up in a few narrow ranges
+ * sortedRuns  ascending runs, each starting somewhere random
+ * mutated     words (e.g. from loadWords("twl.txt")) with letters changed,
+ *             added or dropped now and then
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace workload {
+
+/**
+ * Steele, Lea and Flood's SplitMix64: one add and a few multiplies and
+ * shifts a number. Here it turns seeds into Xoshiro256 states.
+ */
+class SplitMix64 {
+    public:
+        explicit SplitMix64(std::uint64_t seed): state{seed} {}
+
+        std::uint64_t next() {
+            std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+    private:
+        std::uint64_t state;
+};
+
+/**
+ * Blackman and Vigna's xoshiro256**. It's a UniformRandomBitGenerator,
+ * so it works with <random> and std::shuffle too.
+ */
+class Xoshiro256 {
+    public:
+        using result_type = std::uint64_t;
+
+        // the stream'th stretch of 2^128 numbers from seed
+        explicit Xoshiro256(std::uint64_t seed, std::uint64_t stream = 0) {
+            SplitMix64 seeder(seed);
+            for (auto& word : s) {
+                word = seeder.next();
+            }
+            for (std::uint64_t i = 0; i < stream; ++i) {
+                jump();
+            }
+        }
+
+        static constexpr result_type min() {
+            return 0;
+        }
+
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        result_type operator()() {
+            return next();
+        }
+
+        std::uint64_t next() {
+            std::uint64_t result = rotl_(s[1] * 5, 7) * 9;
+            std::uint64_t t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl_(s[3], 45);
+            return result;
+        }
+
+        /**
+         * Uniform in [0, n), by Lemire's multiply-and-shift, which only
+         * divides in the rare case it has to reject a draw to stay unbiased.
+         * n must be at least 1.
+         */
+        std::uint64_t below(std::uint64_t n) {
+            unsigned __int128 m = static_cast<unsigned __int128>(next()) * n;
+            std::uint64_t low = static_cast<std::uint64_t>(m);
+            if (low < n) {
+                std::uint64_t threshold = -n % n;
+                while (low < threshold) {
+                    m = static_cast<unsigned __int128>(next()) * n;
+                    low = static_cast<std::uint64_t>(m);
+                }
+            }
+            return static_cast<std::uint64_t>(m >> 64);
+        }
+
+        // uniform in [low, high]
+        long between(long low, long high) {
+            return low + static_cast<long>(below(static_cast<std::uint64_t>(high - low) + 1));
+        }
+
+        // uniform in [0, 1)
+        double unit() {
+            return (next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        // skips 2^128 numbers ahead
+        void jump() {
+            static const std::uint64_t jumps[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                                  0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+            std::uint64_t t[4] = {0, 0, 0, 0};
+            for (auto jump : jumps) {
+                for (int b = 0; b < 64; ++b) {
+                    if (jump & (std::uint64_t(1) << b)) {
+                        for (int i = 0; i < 4; ++i) {
+                            t[i] ^= s[i];
+                        }
+                    }
+                    next();
+                }
+            }
+            for (int i = 0; i < 4; ++i) {
+                s[i] = t[i];
+            }
+        }
+
+    private:
+        static std::uint64_t rotl_(std::uint64_t x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        std::uint64_t s[4];
+};
+
+/**
+ * Ranks from 0 to n - 1, rank 0 the most likely, with probability falling
+ * off as 1 / (rank + 1)^theta; by Gray et al.'s method from "Quickly
+ * generating billion-record synthetic databases". Building one sums n
+ * terms; drawing is constant time, so share one between threads.
+ */
+class Zipf {
+    public:
+        explicit Zipf(std::uint64_t n_, double theta_ = 0.99): n{n_}, theta{theta_} {
+            for (std::uint64_t i = 1; i <= n; ++i) {
+                zetaN += 1 / std::pow(double(i), theta);
+            }
+            double zeta2 = 1 + 1 / std::pow(2.0, theta);
+            alpha = 1 / (1 - theta);
+            eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetaN);
+        }
+
+        std::uint64_t operator()(Xoshiro256& rng) const {
+            double u = rng.unit();
+            double uz = u * zetaN;
+            if (uz < 1) {
+                return 0;
+            }
+            if (uz < 1 + std::pow(0.5, theta)) {
+                return 1;
+            }
+            auto rank = static_cast<std::uint64_t>(n * std::pow(eta * u - eta + 1, alpha));
+            return rank < n ? rank : n - 1;
+        }
+
+    private:
+        std::uint64_t n;
+        double theta;
+        double zetaN = 0;
+        double alpha;
+        double eta;
+};
+
+// Fisher-Yates
+template <typename T>
+void shuffle(Xoshiro256& rng, std::vector<T>& items) {
+    for (std::size_t i = items.size(); i > 1; --i) {
+        std::swap(items[i - 1], items[rng.below(i)]);
+    }
+}
+
+inline std::vector<long> uniform(Xoshiro256& rng, std::size_t count, long low, long high) {
+    std::vector<long> keys;
+    keys.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        keys.push_back(rng.between(low, high));
+    }
+    return keys;
+}
+
+// ranks out of a million, each scattered to a key of its own in [low, high]
+inline std::vector<long> zipf(Xoshiro256& rng, std::size_t count, long low, long high, double theta = 0.99) {
+    static const std::uint64_t kRanks = 1000000;
+    Zipf ranks(kRanks, theta);
+    std::uint64_t range = static_cast<std::uint64_t>(high - low) + 1;
+    std::vector<long> keys;
+    keys.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        // SplitMix64's output is a good enough hash to scatter a rank with
+        keys.push_back(low + static_cast<long>(SplitMix64(ranks(rng)).next() % range));
+    }
+    return keys;
+}
+
+// clusters ranges width wide, evenly spaced over [low, high]
+inline std::vector<long> clustered(Xoshiro256& rng, std::size_t count, long low, long high, long clusters,
+                                   long width) {
+    std::vector<long> keys;
+    keys.reserve(count);
+    long spacing = (high - low) / clusters;
+    for (std::size_t i = 0; i < count; ++i) {
+        keys.push_back(low + rng.between(0, clusters - 1) * spacing + rng.between(0, width - 1));
+    }
+    return keys;
+}
+
+// runs of runLength ascending keys, each starting somewhere in [low, high] and going up by 1 to step
+inline std::vector<long> sortedRuns(Xoshiro256& rng, std::size_t count, long low, long high, std::size_t runLength,
+                                    long step = 1) {
+    std::vector<long> keys;
+    keys.reserve(count);
+    while (keys.size() < count) {
+        long key = rng.between(low, high);
+        for (std::size_t i = 0; i < runLength && keys.size() < count; ++i) {
+            keys.push_back(key);
+            key += rng.between(1, step);
+        }
+    }
+    return keys;
+}
+
+// one word a line
+inline std::vector<std::string> loadWords(const std::string& path) {
+    std::vector<std::string> words;
+    std::ifstream file(path);
+    std::string word;
+    while (std::getline(file, word)) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+/**
+ * count words drawn from words, each changed with probability
+ * mutationRate: a letter replaced, added or dropped (letters being
+ * uppercase, like twl.txt's). Mutated words are mostly not in words, so
+ * make good misses.
+ */
+inline std::vector<std::string> mutated(Xoshiro256& rng, const std::vector<std::string>& words, std::size_t count,
+                                        double mutationRate) {
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        std::string word = words[rng.below(words.size())];
+        if (rng.unit() < mutationRate) {
+            char letter = static_cast<char>('A' + rng.below(26));
+            std::size_t at = rng.below(word.size() + 1);
+            switch (word.empty() ? 1 : rng.below(3)) {
+                case 0:
+                    word[at < word.size() ? at : at - 1] = letter;
+                    break;
+                case 1:
+                    word.insert(word.begin() + at, letter);
+                    break;
+                default:
+                    word.erase(at < word.size() ? at : at - 1, 1);
+                    break;
+            }
+        }
+        keys.push_back(std::move(word));
+    }
+    return keys;
+}
+
+}  // namespace workload
+
+#endif
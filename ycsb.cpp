@@ -0,0 +1,361 @@
+/**
+ * A YCSB-style load generator: loads a btree of records, then has some
+ * threads hammer it with a mix of reads, updates, inserts, scans and
+ * erases for a while, reporting throughput and latency percentiles for
+ * each interval and for the run as a whole.
+ *
+ *     g++ -std=c++17 -O2 -DNDEBUG -pthread ycsb.cpp -o ycsb
+ *     ./ycsb workload=a threads=4 seconds=10 distribution=zipfian
+ *
+ * Options are name=value:
+ *
+ * workload      a preset mix, as in YCSB: a (50% read, 50% update),
+ *               b (95/5 read/update), c (all reads), d (95% read, 5%
+ *               insert, reading the latest), e (95% scan, 5% insert)
+ * read, update, insert, scan, erase
+ *               the proportion of each op, overriding the preset's
+ * distribution  which existing records ops pick: uniform, zipfian,
+ *               latest (zipfian, most recently inserted first) or
+ *               sequential
+ * records       how many records to load first (default 1000000)
+ * value_size    bytes in each record's value (default 100)
+ * threads       how many threads run ops (default 1)
+ * seconds       how long they run for (default 10)
+ * interval      seconds between reports (default 1)
+ * max_scan      scans read between 1 and this many records (default 100)
+ * fanout        the tree's maxNodeElems (default 64)
+ *
+ * As in YCSB, record n's key is a hash of n, so records go in scattered
+ * rather than in order (which here would build long chains of nodes).
+ * The tree isn't thread-safe, so ops take a std::shared_mutex: shared
+ * for reads and scans, exclusive for the rest.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "btree.h"
+#include "btree_latency.h"
+#include "workload.h"
+
+namespace {
+
+enum Op { kRead, kUpdate, kInsert, kScan, kErase, kNumOps };
+const char* const kOpNames[] = {"read", "update", "insert", "scan", "erase"};
+
+struct Record {
+    std::uint64_t key;
+    std::string value;
+
+    // records are ordered by key alone
+    bool operator<(const Record& other) const { return key < other.key; }
+    bool operator==(const Record& other) const { return key == other.key; }
+};
+
+struct Options {
+    double mix[kNumOps] = {0.5, 0.5, 0, 0, 0};
+    std::string distribution = "zipfian";
+    std::size_t records = 1000000;
+    std::size_t valueSize = 100;
+    unsigned threads = 1;
+    double seconds = 10;
+    double interval = 1;
+    std::size_t maxScan = 100;
+    std::size_t fanout = 64;
+};
+
+// FNV-1a over n's bytes, which is what YCSB scatters its keys with
+std::uint64_t fnv(std::uint64_t n) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 8; ++i) {
+        hash ^= n & 0xff;
+        hash *= 0x100000001b3ULL;
+        n >>= 8;
+    }
+    return hash;
+}
+
+struct Store {
+    explicit Store(std::size_t fanout): tree(fanout) {}
+    btree<Record> tree;
+    std::shared_mutex mutex;
+    // records numbered below this have been handed out for inserting
+    std::atomic<std::uint64_t> inserted{0};
+};
+
+// one thread's histograms since the last report; the mutex is only contended when reporting
+struct ThreadStats {
+    std::mutex mutex;
+    btree_latency_histogram histograms[kNumOps];
+};
+
+class Worker {
+    public:
+        Worker(const Options& options_, Store& store_, const workload::Zipf& zipf_, ThreadStats& stats_, unsigned stream)
+            : options{options_}, store{store_}, zipf{zipf_}, stats{stats_}, rng{6771, stream}, cursor{stream} {
+            double sum = 0;
+            for (int op = 0; op < kNumOps; ++op) {
+                sum += options.mix[op];
+                cumulative[op] = sum;
+            }
+            for (auto& bound : cumulative) {
+                bound /= sum;
+            }
+        }
+
+        void run(const std::atomic<bool>& stop) {
+            while (!stop.load(std::memory_order_relaxed)) {
+                Op op = pickOp_();
+                std::uint64_t start = btree_latency_clock::now();
+                doOp_(op);
+                std::uint64_t finish = btree_latency_clock::now();
+                std::lock_guard<std::mutex> lock(stats.mutex);
+                stats.histograms[op].record(finish - start);
+            }
+        }
+
+    private:
+        Op pickOp_() {
+            double u = rng.unit();
+            for (int op = 0; op < kNumOps - 1; ++op) {
+                if (u < cumulative[op]) {
+                    return static_cast<Op>(op);
+                }
+            }
+            return kErase;
+        }
+
+        // an existing record's key, chosen by the distribution
+        std::uint64_t pickKey_() {
+            std::uint64_t count = store.inserted.load(std::memory_order_relaxed);
+            std::uint64_t n;
+            if (options.distribution == "uniform") {
+                n = rng.below(count);
+            } else if (options.distribution == "sequential") {
+                n = cursor++ % count;
+            } else if (options.distribution == "latest") {
+                std::uint64_t rank = zipf(rng);
+                n = rank < count ? count - 1 - rank : 0;
+            } else {
+                // scrambled, so the popular records are all over the tree
+                n = fnv(zipf(rng)) % count;
+            }
+            return fnv(n);
+        }
+
+        std::string value_() {
+            return std::string(options.valueSize, static_cast<char>('a' + rng.below(26)));
+        }
+
+        void doOp_(Op op) {
+            switch (op) {
+                case kRead: {
+                    std::shared_lock<std::shared_mutex> lock(store.mutex);
+                    const auto& tree = store.tree;
+                    bench::doNotOptimise(tree.find(Record{pickKey_(), {}}) != tree.end());
+                    break;
+                }
+                case kUpdate: {
+                    std::string value = value_();
+                    std::unique_lock<std::shared_mutex> lock(store.mutex);
+                    // records can't be changed in place, so take it out and put it back
+                    auto record = store.tree.extract(Record{pickKey_(), {}});
+                    if (!record.empty()) {
+                        record.value().value = std::move(value);
+                        store.tree.insert(std::move(record));
+                    }
+                    break;
+                }
+                case kInsert: {
+                    Record record{fnv(store.inserted.fetch_add(1)), value_()};
+                    std::unique_lock<std::shared_mutex> lock(store.mutex);
+                    store.tree.insert(std::move(record));
+                    break;
+                }
+                case kScan: {
+                    std::size_t length = 1 + rng.below(options.maxScan);
+                    std::shared_lock<std::shared_mutex> lock(store.mutex);
+                    const auto& tree = store.tree;
+                    std::size_t bytes = 0;
+                    auto it = tree.lower_bound(Record{pickKey_(), {}});
+                    for (std::size_t i = 0; i < length && it != tree.end(); ++i, ++it) {
+                        bytes += it->value.size();
+                    }
+                    bench::doNotOptimise(bytes);
+                    break;
+                }
+                default: {
+                    std::unique_lock<std::shared_mutex> lock(store.mutex);
+                    store.tree.erase(Record{pickKey_(), {}});
+                    break;
+                }
+            }
+        }
+
+        const Options& options;
+        Store& store;
+        const workload::Zipf& zipf;
+        ThreadStats& stats;
+        workload::Xoshiro256 rng;
+        std::uint64_t cursor;
+        double cumulative[kNumOps];
+};
+
+// throughput and percentiles for each op with anything recorded
+void report(const std::string& when, const btree_latency_histogram (&histograms)[kNumOps], double seconds) {
+    std::uint64_t ops = 0;
+    for (const auto& histogram : histograms) {
+        ops += histogram.count();
+    }
+    std::cout << when << " " << std::fixed << std::setprecision(0) << ops / seconds << " ops/s\n";
+    for (int op = 0; op < kNumOps; ++op) {
+        if (histograms[op].count() > 0) {
+            std::cout << "    " << std::left << std::setw(7) << kOpNames[op] << std::right << std::setprecision(1)
+                      << histograms[op].summary() << "\n";
+        }
+    }
+}
+
+bool parse(int argc, char** argv, Options& options) {
+    const std::map<std::string, std::vector<double>> presets = {
+        {"a", {0.5, 0.5, 0, 0, 0}},   {"b", {0.95, 0.05, 0, 0, 0}}, {"c", {1, 0, 0, 0, 0}},
+        {"d", {0.95, 0, 0.05, 0, 0}}, {"e", {0, 0, 0.05, 0.95, 0}},
+    };
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto equals = arg.find('=');
+        if (equals == std::string::npos) {
+            std::cerr << "expected name=value, not " << arg << "\n";
+            return false;
+        }
+        std::string name = arg.substr(0, equals);
+        std::string value = arg.substr(equals + 1);
+        if (name == "workload") {
+            auto preset = presets.find(value);
+            if (preset == presets.end()) {
+                std::cerr << "no workload " << value << "\n";
+                return false;
+            }
+            std::copy(preset->second.begin(), preset->second.end(), options.mix);
+            if (value == "d") {
+                options.distribution = "latest";
+            }
+        } else if (name == "distribution") {
+            if (value != "uniform" && value != "zipfian" && value != "latest" && value != "sequential") {
+                std::cerr << "no distribution " << value << "\n";
+                return false;
+            }
+            options.distribution = value;
+        } else if (name == "records") {
+            options.records = std::stoul(value);
+        } else if (name == "value_size") {
+            options.valueSize = std::stoul(value);
+        } else if (name == "threads") {
+            options.threads = std::stoul(value);
+        } else if (name == "seconds") {
+            options.seconds = std::stod(value);
+        } else if (name == "interval") {
+            options.interval = std::stod(value);
+        } else if (name == "max_scan") {
+            options.maxScan = std::stoul(value);
+        } else if (name == "fanout") {
+            options.fanout = std::stoul(value);
+        } else {
+            bool found = false;
+            for (int op = 0; op < kNumOps; ++op) {
+                if (name == kOpNames[op]) {
+                    options.mix[op] = std::stod(value);
+                    found = true;
+                }
+            }
+            if (!found) {
+                std::cerr << "no option " << name << "\n";
+                return false;
+            }
+        }
+    }
+    if (options.records == 0 || options.threads == 0 || options.maxScan == 0) {
+        std::cerr << "records, threads and max_scan must be at least 1\n";
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        return 1;
+    }
+
+    Store store(options.fanout);
+    double ns = bench::timeNs([&] {
+        for (std::size_t n = 0; n < options.records; ++n) {
+            store.tree.insert(Record{fnv(n), std::string(options.valueSize, 'a' + n % 26)});
+        }
+    });
+    store.inserted = options.records;
+    bench::report("load", options.records, ns);
+
+    workload::Zipf zipf(options.records);
+    std::vector<ThreadStats> stats(options.threads);
+    std::vector<Worker> workers;
+    for (unsigned t = 0; t < options.threads; ++t) {
+        workers.emplace_back(options, store, zipf, stats[t], t);
+    }
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (auto& worker : workers) {
+        threads.emplace_back([&worker, &stop] { worker.run(stop); });
+    }
+
+    // each interval, take what the threads have recorded and add it to the run's
+    btree_latency_histogram totals[kNumOps];
+    auto start = std::chrono::steady_clock::now();
+    auto last = start;
+    while (true) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double wait = std::min(options.interval, options.seconds - elapsed);
+        if (wait <= 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        btree_latency_histogram interval[kNumOps];
+        for (auto& thread : stats) {
+            std::lock_guard<std::mutex> lock(thread.mutex);
+            for (int op = 0; op < kNumOps; ++op) {
+                interval[op].merge(thread.histograms[op]);
+                thread.histograms[op] = btree_latency_histogram();
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        double since = std::chrono::duration<double>(now - start).count();
+        std::ostringstream when;
+        when << "[" << std::fixed << std::setprecision(1) << std::setw(6) << since << "s]";
+        report(when.str(), interval, std::chrono::duration<double>(now - last).count());
+        for (int op = 0; op < kNumOps; ++op) {
+            totals[op].merge(interval[op]);
+        }
+        last = now;
+    }
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // whatever was done after the last report isn't counted
+    report("total", totals, std::chrono::duration<double>(last - start).count());
+    return 0;
+}